@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "allocation-counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+// per thread, so that threads the code under test starts in the background don't count
+thread_local std::size_t total_allocations = 0;
+thread_local std::size_t total_bytes = 0;
+
+void* counted_alloc(std::size_t size)
+{
+    total_allocations++;
+    total_bytes += size;
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+AllocationCounter::AllocationCounter()
+    : allocations_(total_allocations),
+      bytes_(total_bytes),
+      stopped_(false)
+{
+}
+
+void AllocationCounter::stop()
+{
+    if (!stopped_)
+    {
+        allocations_ = total_allocations - allocations_;
+        bytes_ = total_bytes - bytes_;
+        stopped_ = true;
+    }
+}
+
+std::size_t AllocationCounter::allocations() const
+{
+    return stopped_ ? allocations_ : total_allocations - allocations_;
+}
+
+std::size_t AllocationCounter::bytes() const
+{
+    return stopped_ ? bytes_ : total_bytes - bytes_;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+
+#include <cstddef>
+
+/*
+   Counts heap allocations made through the global operator new of the
+   process it is linked into, between construction and stop(). Only the
+   allocations of the thread that constructed the counter are counted.
+*/
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+
+    void stop();
+
+    std::size_t allocations() const;
+    std::size_t bytes() const;
+
+private:
+    std::size_t allocations_;
+    std::size_t bytes_;
+    bool stopped_;
+};
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+   Runs aggregated searches against fake child scopes with configurable result
+   counts, latencies and failure rates, and reports end-to-end latency, time to
+   first result, forwarder overhead per result, and how much is held in the
+   forwarder buffers while earlier children are still outstanding.
+
+   Options: --children=N --results=N --latency=DIST --first-latency=DIST
+            --interval-ms=MS --failure-rate=P --iterations=N --top-k=N
+   where DIST is fixed:MS, uniform:MIN,MAX or lognormal:MEDIAN,SIGMA (in ms).
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/ChildScope.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockQueryCtrl.h>
+#include <unity/scopes/testing/MockScope.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/ScopeMetadataBuilder.h>
+
+#include "synthetic-library.h"
+
+#ifdef VIDEO_AGGREGATOR
+#include "../src/videoaggregator/videoaggregatorquery.h"
+typedef VideoAggregatorQuery AggregatorQuery;
+static const char AGGREGATOR_ID[] = "videoaggregator";
+static const char LOCAL_SCOPE_ID[] = "mediascanner-video";
+#else
+#include "../src/musicaggregator/musicaggregatorquery.h"
+typedef MusicAggregatorQuery AggregatorQuery;
+static const char AGGREGATOR_ID[] = "musicaggregator";
+static const char LOCAL_SCOPE_ID[] = "mediascanner-music";
+#endif
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Matcher;
+using ::testing::Return;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace
+{
+
+class Latency
+{
+public:
+    explicit Latency(std::string const& spec)
+    {
+        auto const colon = spec.find(':');
+        kind_ = spec.substr(0, colon);
+        if (colon != std::string::npos)
+        {
+            const std::string params = spec.substr(colon + 1);
+            a_ = atof(params.c_str());
+            auto const comma = params.find(',');
+            b_ = comma != std::string::npos ? atof(params.c_str() + comma + 1) : a_;
+        }
+        if (kind_ != "fixed" && kind_ != "uniform" && kind_ != "lognormal")
+        {
+            throw std::invalid_argument("unknown latency distribution: " + spec);
+        }
+    }
+
+    std::chrono::microseconds sample(std::mt19937& random) const
+    {
+        double ms = a_;
+        if (kind_ == "uniform")
+        {
+            ms = std::uniform_real_distribution<double>(a_, b_)(random);
+        }
+        else if (kind_ == "lognormal")
+        {
+            ms = std::lognormal_distribution<double>(std::log(a_), b_)(random);
+        }
+        return std::chrono::microseconds(static_cast<long>(ms * 1000));
+    }
+
+private:
+    std::string kind_;
+    double a_ = 0;
+    double b_ = 0;
+};
+
+struct Options
+{
+    int children = 5;
+    int results = 20;
+    std::string latency = "lognormal:80,0.6";
+    std::string first_latency;
+    double interval_ms = 0.5;
+    double failure_rate = 0.0;
+    int iterations = 20;
+    int top_k = 0;
+};
+
+Options parse_options(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        auto const eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq != std::string::npos ? arg.substr(eq + 1) : "";
+        if (key == "--children") options.children = atoi(value.c_str());
+        else if (key == "--results") options.results = atoi(value.c_str());
+        else if (key == "--latency") options.latency = value;
+        else if (key == "--first-latency") options.first_latency = value;
+        else if (key == "--interval-ms") options.interval_ms = atof(value.c_str());
+        else if (key == "--failure-rate") options.failure_rate = atof(value.c_str());
+        else if (key == "--iterations") options.iterations = atoi(value.c_str());
+        else if (key == "--top-k") options.top_k = atoi(value.c_str());
+        else throw std::invalid_argument("unknown option: " + arg);
+    }
+    return options;
+}
+
+// what happened during one aggregated search
+struct Run
+{
+    std::mutex mutex;
+    std::condition_variable done;
+    int children_left = 0;
+
+    Clock::time_point start;
+    std::atomic<long> first_result_us{-1};
+    std::atomic<long> delivered{0};
+    std::atomic<long> forwarded{0};
+    std::atomic<long> peak_buffered{0};
+    std::atomic<long> push_ns{0};
+
+    void child_pushed(long ns)
+    {
+        push_ns += ns;
+        update_peak(++delivered - forwarded);
+    }
+
+    void result_forwarded()
+    {
+        ++forwarded;
+        long expected = -1;
+        first_result_us.compare_exchange_strong(expected,
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    }
+
+    void update_peak(long buffered)
+    {
+        long peak = peak_buffered;
+        while (buffered > peak && !peak_buffered.compare_exchange_weak(peak, buffered))
+        {
+        }
+    }
+};
+
+// a child scope answering from a thread of its own
+class FakeChild
+{
+public:
+    FakeChild(int index, Options const& options, Latency const& latency, Category::SCPtr const& category)
+        : scope_(new ::testing::NiceMock<unity::scopes::testing::MockScope>(std::to_string(index), std::to_string(index))),
+          ctrl_(new unity::scopes::testing::MockQueryCtrl()),
+          index_(index),
+          options_(options),
+          latency_(latency),
+          category_(category)
+    {
+        ON_CALL(*scope_, search(_, _, _, _, _)).WillByDefault(Invoke(
+            [this](std::string const&, std::string const&, FilterState const&, SearchMetadata const&,
+                    SearchListenerBase::SPtr const& listener) -> QueryCtrlProxy {
+                threads_.emplace_back(&FakeChild::answer, this, listener);
+                return ctrl_;
+            }));
+    }
+
+    ~FakeChild()
+    {
+        join();
+    }
+
+    void set_run(Run* run)
+    {
+        run_ = run;
+    }
+
+    void join()
+    {
+        for (auto& thread: threads_)
+        {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    ScopeProxy proxy() const
+    {
+        return ScopeProxy(scope_);
+    }
+
+private:
+    void answer(SearchListenerBase::SPtr listener)
+    {
+        std::mt19937 random(index_ * 7919 + run_->delivered);
+        std::this_thread::sleep_for(latency_.sample(random));
+
+        const bool fail = std::uniform_real_distribution<double>(0, 1)(random) < options_.failure_rate;
+        const int count = fail ? options_.results / 2 : options_.results;
+        for (int i = 0; i < count; i++)
+        {
+            CategorisedResult result(category_);
+            result.set_uri("http://example.com/" + std::to_string(index_) + "/" + std::to_string(i));
+            result.set_title(synthetic_words[(index_ + i) % synthetic_words.size()]);
+            result.set_art("http://example.com/art/" + std::to_string(i) + ".jpg");
+            result["subtitle"] = synthetic_words[i % synthetic_words.size()];
+
+            auto const start = Clock::now();
+            listener->push(result);
+            run_->child_pushed(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+            if (options_.interval_ms > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long>(options_.interval_ms * 1000)));
+            }
+        }
+        listener->finished(fail ? CompletionDetails(CompletionDetails::Error, "injected failure")
+                                : CompletionDetails(CompletionDetails::OK));
+
+        std::lock_guard<std::mutex> lock(run_->mutex);
+        if (--run_->children_left == 0)
+        {
+            run_->done.notify_all();
+        }
+    }
+
+    std::shared_ptr<::testing::NiceMock<unity::scopes::testing::MockScope>> scope_;
+    std::shared_ptr<unity::scopes::testing::MockQueryCtrl> ctrl_;
+    const int index_;
+    Options const& options_;
+    const Latency latency_;
+    const Category::SCPtr category_;
+    Run* run_ = nullptr;
+    std::vector<std::thread> threads_;
+};
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    try
+    {
+        options = parse_options(argc, argv);
+    }
+    catch (std::exception const& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    Category::SCPtr child_category = std::make_shared<unity::scopes::testing::Category>(
+        "child", "Child", "icon", CategoryRenderer());
+
+    std::vector<std::unique_ptr<FakeChild>> children;
+    ChildScopeList child_scopes;
+    for (int i = 0; i < options.children; i++)
+    {
+        const Latency latency(i == 0 && !options.first_latency.empty() ? options.first_latency : options.latency);
+        children.emplace_back(new FakeChild(i, options, latency, child_category));
+        const std::string id = i == 0 ? LOCAL_SCOPE_ID : "fake-" + std::to_string(i);
+        child_scopes.push_back({id, unity::scopes::testing::ScopeMetadataBuilder()
+            .scope_id(id)
+                .display_name(id).description(" ")
+                .author(" ")
+                .proxy(children.back()->proxy())()});
+    }
+
+    // rough size of what a buffered result keeps alive
+    CategorisedResult sample(child_category);
+    sample.set_uri("http://example.com/0/0");
+    sample.set_title(synthetic_words[0]);
+    sample.set_art("http://example.com/art/0.jpg");
+    sample["subtitle"] = synthetic_words[0];
+    const std::size_t result_bytes = Variant(sample.serialize()).serialize_json().size();
+
+    std::vector<double> end_to_end;
+    std::vector<double> first_result;
+    std::vector<double> push_overhead_us;
+    long peak_buffered = 0;
+
+    for (int iteration = 0; iteration < options.iterations; iteration++)
+    {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        std::mutex categories_mutex;
+        std::map<std::string, Category::SCPtr> categories;
+        auto const register_category = [&](std::string const& id) {
+            std::lock_guard<std::mutex> lock(categories_mutex);
+            auto& category = categories[id];
+            if (!category)
+            {
+                category = std::make_shared<unity::scopes::testing::Category>(id, id, "icon", CategoryRenderer());
+            }
+            return category;
+        };
+        ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Invoke(
+            [&](std::string const& id, std::string const&, std::string const&, CategoryRenderer const&) {
+                return register_category(id);
+            }));
+        ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Invoke(
+            [&](std::string const& id, std::string const&, std::string const&, CannedQuery const&, CategoryRenderer const&) {
+                return register_category(id);
+            }));
+        ON_CALL(reply, lookup_category(_)).WillByDefault(Invoke([&](std::string const& id) {
+                std::lock_guard<std::mutex> lock(categories_mutex);
+                auto it = categories.find(id);
+                return it != categories.end() ? it->second : Category::SCPtr();
+            }));
+
+        Run run;
+        run.children_left = options.children;
+        ON_CALL(reply, push(Matcher<CategorisedResult const&>(_))).WillByDefault(Invoke([&run](CategorisedResult const&) {
+                run.result_forwarded();
+                return true;
+            }));
+        for (auto& child: children)
+        {
+            child->set_run(&run);
+        }
+
+        // a new query string every time, so that nothing gets coalesced
+        CannedQuery q(AGGREGATOR_ID, "bench " + std::to_string(iteration), "");
+        SearchMetadata hints("en_AU", "phone");
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        {
+            AggregatorQuery query(q, hints, child_scopes, nullptr, options.top_k);
+            run.start = Clock::now();
+            query.run(proxy);
+
+            std::unique_lock<std::mutex> lock(run.mutex);
+            run.done.wait(lock, [&run] { return run.children_left == 0; });
+        }
+        end_to_end.push_back(std::chrono::duration<double, std::milli>(Clock::now() - run.start).count());
+        for (auto& child: children)
+        {
+            child->join();
+        }
+
+        if (run.first_result_us >= 0)
+        {
+            first_result.push_back(run.first_result_us / 1000.0);
+        }
+        if (run.delivered > 0)
+        {
+            push_overhead_us.push_back(run.push_ns / 1000.0 / run.delivered);
+        }
+        peak_buffered = std::max(peak_buffered, run.peak_buffered.load());
+    }
+
+    printf("%s: %d children, %d results each, latency %s, failure rate %.2f, top-k %d\n",
+            AGGREGATOR_ID, options.children, options.results, options.latency.c_str(), options.failure_rate, options.top_k);
+    printf("  end to end:           %s\n", percentiles(end_to_end).c_str());
+    printf("  first result:         %s\n", percentiles(first_result).c_str());
+    printf("  forwarder per result: %s\n", percentiles(push_overhead_us, "us").c_str());
+    printf("  buffered at peak:     %ld results, ~%zu kB\n", peak_buffered, peak_buffered * result_bytes / 1024);
+    return 0;
+}
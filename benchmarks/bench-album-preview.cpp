@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockPreviewReply.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Matcher;
+using ::testing::Return;
+
+/*
+   What embedding track lists in album results (MEDIASCANNER_EMBED_ALBUM_TRACKS)
+   costs the albums query and its payload, against what it saves the previews
+   of those albums.
+*/
+
+namespace
+{
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+// (library size, albums embedded per query)
+class AlbumPreviewBenchmark : public unity::scopes::testing::TypedScopeFixture<MusicScope>,
+                              public ::testing::WithParamInterface<std::tuple<int, int>>
+{
+protected:
+    virtual void SetUp() override
+    {
+        use_synthetic_library(std::get<0>(GetParam()));
+        setenv("MEDIASCANNER_EMBED_ALBUM_TRACKS", std::to_string(std::get<1>(GetParam())).c_str(), 1);
+        // every run of the query has to build its results
+        setenv("MEDIASCANNER_RESULT_CACHE", "0", 1);
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+
+    virtual void TearDown() override
+    {
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::TearDown();
+        unsetenv("MEDIASCANNER_EMBED_ALBUM_TRACKS");
+        unsetenv("MEDIASCANNER_RESULT_CACHE");
+    }
+};
+
+TEST_P(AlbumPreviewBenchmark, AlbumsThenPreviews)
+{
+    const int size = std::get<0>(GetParam());
+    const int embedded = std::get<1>(GetParam());
+
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> search_reply;
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "albums", "Albums", "icon", CategoryRenderer());
+    ON_CALL(search_reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+    SearchReplyProxy search_proxy(&search_reply, [](SearchReply*){});
+
+    // the first run looks every embedded track list up, later ones find them in the album tracks cache
+    std::vector<CategorisedResult> albums;
+    std::size_t payload = 0;
+    double first_run = 0;
+    std::vector<double> timings;
+    const int iterations = benchmark_iterations(20);
+    for (int i = 0; i <= iterations; i++)
+    {
+        albums.clear();
+        payload = 0;
+        auto query = scope->search(CannedQuery("mediascanner-music", "", "albums"), SearchMetadata("en_AU", "phone"));
+        auto const start = std::chrono::steady_clock::now();
+        dynamic_cast<MusicQuery&>(*query).run_in_process(search_proxy, [&albums, &payload](CategorisedResult const& result) {
+                albums.push_back(result);
+                payload += Variant(result.serialize()).serialize_json().size();
+                return true;
+            });
+        const double ms = elapsed_ms(start);
+        if (i == 0)
+        {
+            first_run = ms;
+        }
+        else
+        {
+            timings.push_back(ms);
+        }
+    }
+    ASSERT_FALSE(albums.empty());
+    printf("embed %2d %8d  albums query: first run %.2f ms, then %s; %zu bytes per result\n",
+           embedded, size, first_run, percentiles(timings).c_str(), payload / albums.size());
+
+    // opening each album of the first page once
+    ::testing::NiceMock<unity::scopes::testing::MockPreviewReply> preview_reply;
+    ON_CALL(preview_reply, push(Matcher<PreviewWidgetList const&>(_))).WillByDefault(Return(true));
+    PreviewReplyProxy preview_proxy(&preview_reply, [](PreviewReply*){});
+    std::vector<double> previews;
+    for (std::size_t i = 0; i < albums.size() && i < 20; i++)
+    {
+        auto previewer = scope->preview(albums[i], ActionMetadata("en_AU", "phone"));
+        auto const start = std::chrono::steady_clock::now();
+        previewer->run(preview_proxy);
+        previews.push_back(elapsed_ms(start));
+    }
+    printf("embed %2d %8d  first preview of an album: %s\n", embedded, size, percentiles(previews).c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, AlbumPreviewBenchmark,
+        ::testing::Combine(::testing::ValuesIn(synthetic_library_sizes()), ::testing::Values(0, 20)));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
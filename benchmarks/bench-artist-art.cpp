@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <core/net/http/client.h>
+#include <core/net/uri.h>
+#include <gtest/gtest.h>
+
+#include "synthetic-library.h"
+#include "../src/utils/artistartcache.h"
+
+namespace http = core::net::http;
+
+/*
+   What the art URI of an artist costs, for 1000 artists: through the HTTP
+   client as the music scope used to make it, with the scope's own escaping,
+   and from the art URI cache once the artists have been seen.
+*/
+
+namespace
+{
+
+const int ARTISTS = 1000;
+
+// runs make_uri for every artist, giving the time per artist in ns of each run
+std::vector<double> per_artist_ns(std::vector<std::string> const& artists,
+        std::function<std::string(std::string const&)> const& make_uri)
+{
+    std::vector<double> timings;
+    const int iterations = benchmark_iterations(20);
+    std::size_t bytes = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        for (auto const& artist: artists)
+        {
+            bytes += make_uri(artist).size();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        timings.push_back(ns / artists.size());
+    }
+    // keeps the calls from being optimised away
+    EXPECT_GT(bytes, 0u);
+    return timings;
+}
+
+}
+
+TEST(ArtistArtBenchmark, PerArtist)
+{
+    std::vector<std::string> artists;
+    for (int i = 0; i < ARTISTS; i++)
+    {
+        artists.push_back(synthetic_words[i % synthetic_words.size()] + " " +
+                          synthetic_words[(i * 7) % synthetic_words.size()] + " Café " + std::to_string(i));
+    }
+    const std::string album = "Sunrise Over Sea";
+
+    auto client = http::make_client();
+    auto const via_client = per_artist_ns(artists, [&client, &album](std::string const& artist) {
+            return client->uri_to_string(core::net::make_uri(
+                    "image://artistart", {}, {{"artist", artist}, {"album", album}}));
+        });
+    auto const escaped = per_artist_ns(artists, [&album](std::string const& artist) {
+            return ArtistArtCache::make_uri(artist, album);
+        });
+    ArtistArtCache cache;
+    for (auto const& artist: artists)
+    {
+        cache.get(artist, album);
+    }
+    auto const cached = per_artist_ns(artists, [&cache, &album](std::string const& artist) {
+            return cache.get(artist, album);
+        });
+
+    printf("%d artists, per artist: http client %s\n", ARTISTS, percentiles(via_client, "ns").c_str());
+    printf("%d artists, per artist: own escape  %s\n", ARTISTS, percentiles(escaped, "ns").c_str());
+    printf("%d artists, per artist: cached      %s\n", ARTISTS, percentiles(cached, "ns").c_str());
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+
+#include "allocation-counter.h"
+#include "../src/utils/bufferedresultforwarder.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Matcher;
+using ::testing::Return;
+
+// BufferedResultForwarder as it used to be: the result gets copied on its way upstream
+class CopyingForwarder : public utility::BufferedResultForwarder
+{
+public:
+    CopyingForwarder(SearchReplyProxy const& upstream,
+            std::function<bool(CategorisedResult&)> const &result_filter = [](CategorisedResult&) -> bool { return true; })
+        : utility::BufferedResultForwarder(upstream),
+          result_filter_(result_filter)
+    {
+    }
+
+    void push(CategorisedResult result) override
+    {
+        if (result_filter_(result))
+        {
+            utility::BufferedResultForwarder::push(result);
+        }
+    }
+
+private:
+    const std::function<bool(CategorisedResult&)> result_filter_;
+};
+
+static std::vector<CategorisedResult> make_results(Category::SCPtr const& category, int count)
+{
+    CategorisedResult result(category);
+    result.set_uri("file:///home/user/Music/Spiderbait/Tonight Alright/Straight Through The Sun.ogg");
+    result.set_title("Straight Through The Sun");
+    result.set_art("image://albumart/artist=Spiderbait&album=Tonight%20Alright");
+    result["artist"] = "Spiderbait";
+    result["album"] = "Tonight Alright";
+    result["duration"] = 235;
+    return std::vector<CategorisedResult>(count, result);
+}
+
+// allocations per result for pushing 'count' results through 'listener' into 'reply'
+static double measure(SearchListenerBase& listener, Category::SCPtr const& category, int count)
+{
+    auto results = make_results(category, count);
+    AllocationCounter counter;
+    for (auto& result: results)
+    {
+        listener.push(std::move(result));
+    }
+    counter.stop();
+    return double(counter.allocations()) / count;
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 10000;
+
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, push(Matcher<CategorisedResult const&>(_))).WillByDefault(Return(true));
+    SearchReplyProxy upstream(&reply, [](SearchReply*){});
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Songs", "icon", CategoryRenderer());
+
+    // what the mock reply costs by itself
+    double direct;
+    {
+        auto results = make_results(category, count);
+        AllocationCounter counter;
+        for (auto const& result: results)
+        {
+            upstream->push(result);
+        }
+        counter.stop();
+        direct = double(counter.allocations()) / count;
+    }
+
+    CopyingForwarder copying(upstream);
+    BufferedResultForwarder moving(upstream, utility::BufferedResultForwarder::SPtr());
+    BufferedResultForwarder filtering(upstream, utility::BufferedResultForwarder::SPtr(), [&category](CategorisedResult& result) {
+        result.set_category(category);
+        return true;
+    });
+
+    const double before = measure(copying, category, count);
+    const double after = measure(moving, category, count);
+    const double filtered = measure(filtering, category, count);
+
+    printf("allocations per forwarded result (mock reply itself: %.2f)\n", direct);
+    printf("  copying forwarder:            %.2f\n", before - direct);
+    printf("  moving forwarder:             %.2f\n", after - direct);
+    printf("  moving forwarder with filter: %.2f\n", filtered - direct);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <mediascanner/MediaStore.hh>
+
+#include "synthetic-library.h"
+#include "../src/utils/mediacatalogue.h"
+
+using namespace mediascanner;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace
+{
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// misspelt or unaccented names from the synthetic library, and one that matches nothing
+const std::vector<std::string> misspelt_queries {
+    "the synthetc band", "midnigth", "electirc", "horizn thunder", "velvt echo",
+    "sumer nihgt", "forver young", "CAFE", "senorita", "deja uber", "zzyzx qqq"
+};
+
+}
+
+class FuzzySearchBenchmark : public ::testing::TestWithParam<int>
+{
+};
+
+// time to take the catalogue snapshot, and to find the closest name to a misspelt query
+TEST_P(FuzzySearchBenchmark, ClosestMatch)
+{
+    use_synthetic_library(GetParam());
+    MediaStore store(MS_READ_ONLY);
+
+    auto start = Clock::now();
+    MediaCatalogue catalogue(store, AudioMedia);
+    const double build_ms = elapsed_ms(start);
+    printf("%8d tracks  catalogue of %zu names taken in %.1f ms, peak RSS %ld kB\n",
+           GetParam(), catalogue.size(), build_ms, peak_rss_kb());
+
+    const int iterations = benchmark_iterations(50);
+    for (auto const& query: misspelt_queries)
+    {
+        std::vector<double> timings;
+        std::string match;
+        for (int i = 0; i < iterations; i++)
+        {
+            start = Clock::now();
+            match = catalogue.closest_match(store, query);
+            timings.push_back(elapsed_ms(start));
+        }
+        printf("%8d tracks  %-20s %s  -> \"%s\"\n", GetParam(), query.c_str(),
+               percentiles(timings).c_str(), match.c_str());
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, FuzzySearchBenchmark, ::testing::ValuesIn(synthetic_library_sizes()));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
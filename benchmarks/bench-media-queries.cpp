@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+#include "../src/myvideos/video-scope.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Matcher;
+using ::testing::Return;
+
+namespace
+{
+
+struct QueryShape
+{
+    std::string name;
+    std::string department;
+    std::string query_string;
+    std::string user_data;
+};
+
+std::vector<QueryShape> music_shapes()
+{
+    return {
+        {"surfacing", "", "", ""},
+        {"search, common word", "", "love", ""},
+        {"search, prefix", "", "mi", ""},
+        {"search, two words", "", "summer night", ""},
+        {"search, no match", "", "zzyzx", ""},
+        {"tracks", "tracks", "", ""},
+        {"tracks, search", "tracks", "love", ""},
+        {"albums", "albums", "", ""},
+        {"albums, search", "albums", "love", ""},
+        {"genres", "genres", "", ""},
+        {"genre", "genre:" + synthetic_genres[0], "", ""},
+        {"albums of artist", "", synthetic_top_artist, "albums_of_artist"},
+    };
+}
+
+std::vector<QueryShape> video_shapes()
+{
+    return {
+        {"surfacing", "", "", ""},
+        {"search, common word", "", "love", ""},
+        {"search, prefix", "", "mi", ""},
+        {"search, two words", "", "summer night", ""},
+        {"search, no match", "", "zzyzx", ""},
+        {"camera", "camera", "", ""},
+        {"downloads", "downloads", "", ""},
+        {"downloads, search", "downloads", "love", ""},
+    };
+}
+
+// runs every query shape against the scope and prints its latency percentiles
+template<typename Scope>
+void run_shapes(Scope& scope, std::string const& scope_id, int size, std::vector<QueryShape> const& shapes)
+{
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, push(Matcher<CategorisedResult const&>(_))).WillByDefault(Return(true));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+    const int iterations = benchmark_iterations(20);
+    for (auto const& shape: shapes)
+    {
+        CannedQuery q(scope_id, shape.query_string, shape.department);
+        if (!shape.user_data.empty())
+        {
+            q.set_user_data(Variant(shape.user_data));
+        }
+        SearchMetadata hints("en_AU", "phone");
+
+        std::vector<double> timings;
+        for (int i = 0; i < iterations; i++)
+        {
+            auto query = scope.search(q, hints);
+            auto const start = std::chrono::steady_clock::now();
+            query->run(proxy);
+            timings.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        printf("%-18s %8d  %-22s %s\n", scope_id.c_str(), size, shape.name.c_str(), percentiles(timings).c_str());
+    }
+    printf("%-18s %8d  peak RSS %ld kB\n", scope_id.c_str(), size, peak_rss_kb());
+}
+
+}
+
+class MusicQueryBenchmark : public unity::scopes::testing::TypedScopeFixture<MusicScope>,
+                            public ::testing::WithParamInterface<int>
+{
+protected:
+    virtual void SetUp() override
+    {
+        use_synthetic_library(GetParam());
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+};
+
+class VideoQueryBenchmark : public unity::scopes::testing::TypedScopeFixture<VideoScope>,
+                            public ::testing::WithParamInterface<int>
+{
+protected:
+    virtual void SetUp() override
+    {
+        use_synthetic_library(GetParam());
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<VideoScope>::SetUp();
+    }
+};
+
+TEST_P(MusicQueryBenchmark, Departments)
+{
+    run_shapes(*scope, "mediascanner-music", GetParam(), music_shapes());
+}
+
+TEST_P(VideoQueryBenchmark, Departments)
+{
+    run_shapes(*scope, "mediascanner-video", GetParam(), video_shapes());
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, MusicQueryBenchmark, ::testing::ValuesIn(synthetic_library_sizes()));
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, VideoQueryBenchmark, ::testing::ValuesIn(synthetic_library_sizes()));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
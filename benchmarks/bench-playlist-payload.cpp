@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Return;
+
+/*
+   Reply size of the song queries whose cards carry an inline playback
+   playlist: as sent, with a window of the songs around each card, and as
+   it would be with every card carrying the playlist of all of the songs.
+*/
+
+namespace
+{
+
+std::size_t payload(std::vector<CategorisedResult> const& results)
+{
+    std::size_t bytes = 0;
+    for (auto const& result: results)
+    {
+        bytes += Variant(result.serialize()).serialize_json().size();
+    }
+    return bytes;
+}
+
+// the results with the playlist of all songs in every card's audio-data
+std::vector<CategorisedResult> with_full_playlists(std::vector<CategorisedResult> results)
+{
+    VariantArray playlist;
+    for (auto const& result: results)
+    {
+        playlist.emplace_back(result.uri());
+    }
+    for (auto& result: results)
+    {
+        auto data = result["audio-data"].get_dict();
+        data["playlist"] = playlist;
+        result["audio-data"] = data;
+    }
+    return results;
+}
+
+}
+
+class PlaylistPayloadBenchmark : public unity::scopes::testing::TypedScopeFixture<MusicScope>,
+                                 public ::testing::WithParamInterface<int>
+{
+protected:
+    virtual void SetUp() override
+    {
+        use_synthetic_library(GetParam());
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+
+    void measure(std::string const& name, CannedQuery const& q, SearchMetadata const& hints)
+    {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+            "songs", "Tracks", "icon", CategoryRenderer());
+        ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+        ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Return(category));
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+        std::vector<CategorisedResult> results;
+        auto query = scope->search(q, hints);
+        dynamic_cast<MusicQuery&>(*query).run_in_process(proxy, [&results](CategorisedResult const& result) {
+                results.push_back(result);
+                return true;
+            });
+        ASSERT_FALSE(results.empty());
+
+        const std::size_t windowed = payload(results);
+        const std::size_t full = payload(with_full_playlists(results));
+        printf("%-22s %8d  %3zu songs: %8zu bytes with full playlists, %8zu bytes with windows (%.1f%%)\n",
+               name.c_str(), GetParam(), results.size(), full, windowed, 100.0 * windowed / full);
+    }
+};
+
+TEST_P(PlaylistPayloadBenchmark, TracksDepartment)
+{
+    measure("tracks", CannedQuery("mediascanner-music", "", "tracks"), SearchMetadata("en_AU", "phone"));
+}
+
+TEST_P(PlaylistPayloadBenchmark, AggregatedSurfacing)
+{
+    SearchMetadata hints("en_AU", "phone");
+    hints.set_aggregated_keywords(std::set<std::string>());
+    measure("aggregated surfacing", CannedQuery("mediascanner-music", "", ""), hints);
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, PlaylistPayloadBenchmark,
+        ::testing::ValuesIn(synthetic_library_sizes()));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+
+#include "../src/utils/bufferedresultforwarder.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Matcher;
+
+typedef std::chrono::steady_clock Clock;
+
+// pushes 'count' results through a forwarder into a mock upstream reply; the child sends
+// them in bursts of 'burst' results with a short pause in between, like a remote scope would.
+static void run(int count, int burst)
+{
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    SearchReplyProxy upstream(&reply, [](SearchReply*){});
+
+    // an upstream wakeup is a push that comes after the upstream has been idle for a while
+    int pushes = 0;
+    int wakeups = 0;
+    Clock::time_point last_push;
+    ON_CALL(reply, push(Matcher<CategorisedResult const&>(_))).WillByDefault(Invoke([&](CategorisedResult const&) -> bool {
+        auto const now = Clock::now();
+        if (pushes == 0 || now - last_push > std::chrono::microseconds(200))
+        {
+            ++wakeups;
+        }
+        last_push = now;
+        ++pushes;
+        return true;
+    }));
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Songs", "icon", CategoryRenderer());
+    CategorisedResult result(category);
+    result.set_uri("file:///home/user/Music/track.mp3");
+    result.set_title("Track");
+    result.set_art("file:///home/user/Music/cover.jpg");
+    result["duration"] = 180;
+
+    auto forwarder = std::make_shared<BufferedResultForwarder>(upstream, utility::BufferedResultForwarder::SPtr());
+
+    auto const start = Clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        forwarder->push(result);
+        if (burst > 0 && (i + 1) % burst == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    forwarder->finished(CompletionDetails(CompletionDetails::OK));
+    auto const elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+    printf("burst %3d: %d results in %8.2f ms, %10.0f results/s, %d upstream pushes, %d upstream wakeups\n",
+            burst, count, elapsed / 1000.0, elapsed > 0 ? count * 1e6 / elapsed : 0.0, pushes, wakeups);
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 100000;
+
+    for (int burst: {1, 5, 50})
+    {
+        run(count, burst);
+    }
+    return 0;
+}
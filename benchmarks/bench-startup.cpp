@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+
+#include "synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+#include "../src/myvideos/video-scope.h"
+
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Matcher;
+using ::testing::Return;
+
+/*
+   Cold start of the scopes: from start to the end of the first query, the
+   surfacing query a swipe to the scope runs. start_in_process() stands in
+   for start(), which needs the scope runtime for the scope directory.
+*/
+
+namespace
+{
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Scope>
+void measure_startup(std::string const& scope_id, int size)
+{
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, push(Matcher<CategorisedResult const&>(_))).WillByDefault(Return(true));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+    std::vector<double> starts, first_queries, totals;
+    const int iterations = benchmark_iterations(20);
+    for (int i = 0; i < iterations; i++)
+    {
+        Scope scope;
+        auto const start = std::chrono::steady_clock::now();
+        scope.start_in_process("/no/such/directory");
+        starts.push_back(elapsed_ms(start));
+
+        auto const query_start = std::chrono::steady_clock::now();
+        auto query = scope.search(CannedQuery(scope_id, "", ""), SearchMetadata("en_AU", "phone"));
+        query->run(proxy);
+        first_queries.push_back(elapsed_ms(query_start));
+        totals.push_back(elapsed_ms(start));
+
+        query.reset();
+        scope.stop();
+    }
+    printf("%-18s %8d  start       %s\n", scope_id.c_str(), size, percentiles(starts).c_str());
+    printf("%-18s %8d  first query %s\n", scope_id.c_str(), size, percentiles(first_queries).c_str());
+    printf("%-18s %8d  total       %s\n", scope_id.c_str(), size, percentiles(totals).c_str());
+}
+
+}
+
+class StartupBenchmark : public ::testing::TestWithParam<int>
+{
+protected:
+    virtual void SetUp() override
+    {
+        use_synthetic_library(GetParam());
+        // a cold start has nothing to replay
+        setenv("MEDIASCANNER_RESULT_CACHE", "0", 1);
+    }
+
+    virtual void TearDown() override
+    {
+        unsetenv("MEDIASCANNER_RESULT_CACHE");
+    }
+};
+
+TEST_P(StartupBenchmark, Music)
+{
+    measure_startup<MusicScope>("mediascanner-music", GetParam());
+}
+
+TEST_P(StartupBenchmark, Video)
+{
+    measure_startup<VideoScope>("mediascanner-video", GetParam());
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, StartupBenchmark,
+        ::testing::ValuesIn(synthetic_library_sizes()));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
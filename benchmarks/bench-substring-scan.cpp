@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <mediascanner/Filter.hh>
+#include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaStore.hh>
+
+#include "synthetic-library.h"
+#include "../src/utils/mediacatalogue.h"
+#include "../src/utils/searchkey.h"
+#include "../src/utils/substringscan.h"
+
+using namespace mediascanner;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace
+{
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// what gets typed first, and a pair of letters that matches nothing
+const std::vector<std::string> typed_queries {"a", "l", "mi", "ni", "ér", "zq"};
+
+// the key column is meant for libraries of around 50k items, unless sizes are asked for
+std::vector<int> library_sizes()
+{
+    return getenv("MEDIASCANNER_BENCH_SIZES") ? synthetic_library_sizes() : std::vector<int>{50000};
+}
+
+// the same column as MediaKeyColumn keeps: folded title, artist and album of every song
+std::string make_column(MediaStore const& store)
+{
+    std::string column;
+    for (auto const& media: store.query("", AudioMedia, Filter()))
+    {
+        column.append(search_key(media.getTitle())).append(1, '\x1f');
+        column.append(search_key(media.getAuthor())).append(1, '\x1f');
+        column.append(search_key(media.getAlbum())).append(1, '\0');
+    }
+    return column;
+}
+
+int count_matches(SubstringFinder finder, std::string const& column, std::string const& key)
+{
+    int count = 0;
+    const char *p = column.data();
+    const char *end = p + column.size();
+    while (const char *match = finder(p, end - p, key.data(), key.size()))
+    {
+        count++;
+        p = match + 1;
+    }
+    return count;
+}
+
+}
+
+class SubstringScanBenchmark : public ::testing::TestWithParam<int>
+{
+};
+
+// scanning the whole column with every kernel the CPU runs
+TEST_P(SubstringScanBenchmark, Kernels)
+{
+    use_synthetic_library(GetParam());
+    MediaStore store(MS_READ_ONLY);
+    const std::string column = make_column(store);
+    printf("%8d songs  column of %zu bytes\n", GetParam(), column.size());
+
+    const int iterations = benchmark_iterations(200);
+    for (auto const& query: typed_queries)
+    {
+        const std::string key = search_key(query);
+        int expected = -1;
+        for (auto const& finder: substring_finders())
+        {
+            std::vector<double> timings;
+            int matches = 0;
+            for (int i = 0; i < iterations; i++)
+            {
+                auto const start = Clock::now();
+                matches = count_matches(finder.second, column, key);
+                timings.push_back(elapsed_ms(start));
+            }
+            if (expected < 0)
+            {
+                expected = matches;
+            }
+            EXPECT_EQ(expected, matches) << finder.first << " disagrees on " << query;
+            printf("%8d songs  %-4s %-6s %6d matches  %s\n", GetParam(), query.c_str(),
+                   finder.first.c_str(), matches, percentiles(timings).c_str());
+        }
+    }
+}
+
+// a page of songs for a query being typed, from the store's full text search and from the
+// key column, the whole way a query takes: checking the column is current, scanning and copying
+TEST_P(SubstringScanBenchmark, StoreAgainstKeyColumn)
+{
+    use_synthetic_library(GetParam());
+    MediaStore store(MS_READ_ONLY);
+    MediaKeyColumnCache columns(AudioMedia);
+    ASSERT_TRUE(columns.wait() != nullptr);
+    Filter filter;
+    filter.setLimit(100);
+
+    const int iterations = benchmark_iterations(50);
+    for (auto const& query: typed_queries)
+    {
+        std::vector<double> store_timings;
+        std::vector<double> column_timings;
+        std::size_t store_results = 0;
+        std::size_t column_results = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            auto start = Clock::now();
+            store_results = store.query(query, AudioMedia, filter).size();
+            store_timings.push_back(elapsed_ms(start));
+
+            start = Clock::now();
+            column_results = columns.get()->media_containing(query, 100).size();
+            column_timings.push_back(elapsed_ms(start));
+        }
+        printf("%8d songs  %-4s store     %3zu results  %s\n", GetParam(), query.c_str(),
+               store_results, percentiles(store_timings).c_str());
+        printf("%8d songs  %-4s column    %3zu results  %s\n", GetParam(), query.c_str(),
+               column_results, percentiles(column_timings).c_str());
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(SyntheticLibrary, SubstringScanBenchmark, ::testing::ValuesIn(library_sizes()));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
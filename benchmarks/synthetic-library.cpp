@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "synthetic-library.h"
+
+#include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBuilder.hh>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace mediascanner;
+
+const std::vector<std::string> synthetic_words {
+    "love", "night", "heart", "sun", "river", "road", "fire", "dream", "city", "rain",
+    "blue", "gold", "summer", "winter", "shadow", "light", "ocean", "wild", "young", "home",
+    "dance", "storm", "star", "moon", "paper", "glass", "silver", "echo", "morning", "highway",
+    "garden", "ghost", "electric", "velvet", "thunder", "wonder", "secret", "forever", "midnight", "horizon",
+    "café", "naïve", "über", "señorita", "déjà", "Москва", "東京", "amour", "corazón", "straße"
+};
+
+const std::string synthetic_top_artist = "The Synthetic Band";
+
+const std::vector<std::string> synthetic_genres {
+    "Rock", "Pop", "Electronic", "Hip-Hop", "Jazz", "Classical", "Folk", "Metal", "Blues", "Country",
+    "Reggae", "Soul", "Punk", "Ambient", "Latin", "Soundtrack", "Indie", "R&B", "World", "Podcast"
+};
+
+namespace
+{
+
+class Generator
+{
+public:
+    explicit Generator(unsigned seed)
+        : random_(seed)
+    {
+    }
+
+    // 1 to 'max' words, so that common words show up in many titles
+    std::string title(int max)
+    {
+        std::uniform_int_distribution<int> count(1, max);
+        std::string text;
+        for (int i = count(random_); i > 0; i--)
+        {
+            if (!text.empty())
+            {
+                text += " ";
+            }
+            text += word();
+        }
+        if (text[0] >= 'a' && text[0] <= 'z')
+        {
+            text[0] += 'A' - 'a';
+        }
+        return text;
+    }
+
+    std::string word()
+    {
+        return synthetic_words[skewed(synthetic_words.size())];
+    }
+
+    std::string genre()
+    {
+        return synthetic_genres[skewed(synthetic_genres.size())];
+    }
+
+    // roughly Zipf distributed index below n: a few items are very common, most are rare
+    int skewed(int n)
+    {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        const double u = uniform(random_);
+        return std::min(n - 1, static_cast<int>(n * u * u * u));
+    }
+
+    int uniform(int min, int max)
+    {
+        std::uniform_int_distribution<int> dist(min, max);
+        return dist(random_);
+    }
+
+private:
+    std::mt19937 random_;
+};
+
+std::vector<int> parse_sizes(std::string const& text)
+{
+    std::vector<int> sizes;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        const int size = atoi(item.c_str());
+        if (size > 0)
+        {
+            sizes.push_back(size);
+        }
+    }
+    return sizes;
+}
+
+}
+
+void populate_synthetic_library(MediaStore& store, int tracks, int videos)
+{
+    Generator gen(42);
+
+    // about 10 albums per artist on average, popular artists having many more
+    const int artist_count = std::max(1, tracks / 100);
+    std::vector<std::string> artists;
+    for (int i = 0; i < artist_count; i++)
+    {
+        artists.push_back(gen.title(3) + " " + std::to_string(i));
+    }
+    artists[0] = synthetic_top_artist;
+
+    int track = 0;
+    int album = 0;
+    while (track < tracks)
+    {
+        const std::string artist = artists[gen.skewed(artist_count)];
+        const std::string album_title = gen.title(3) + " " + std::to_string(album);
+        const std::string genre = gen.genre();
+        const std::string year = std::to_string(gen.uniform(1960, 2016));
+        const int album_tracks = gen.uniform(8, 14);
+        for (int n = 1; n <= album_tracks && track < tracks; n++, track++)
+        {
+            MediaFileBuilder builder("/home/user/Music/" + std::to_string(album) + "/" + std::to_string(n) + ".ogg");
+            builder.setType(AudioMedia);
+            builder.setTitle(gen.title(4));
+            builder.setAuthor(artist);
+            builder.setAlbum(album_title);
+            builder.setAlbumArtist(artist);
+            builder.setGenre(genre);
+            builder.setDate(year + "-01-01");
+            builder.setTrackNumber(n);
+            builder.setDuration(gen.uniform(90, 420));
+            builder.setModificationTime(1400000000 + track);
+            store.insert(builder.build());
+        }
+        album++;
+    }
+
+    for (int i = 0; i < videos; i++)
+    {
+        char camera_name[64];
+        snprintf(camera_name, sizeof(camera_name), "video2014%02d%02d_%04d.mp4", i % 12 + 1, i % 28 + 1, i % 10000);
+        const bool camera = gen.uniform(0, 2) == 0;
+        MediaFileBuilder builder(camera ? "/home/user/Videos/" + std::to_string(i) + "/" + camera_name
+                : "/home/user/Videos/" + std::to_string(i) + ".mp4");
+        builder.setType(VideoMedia);
+        builder.setTitle(camera ? std::string("From camera") : gen.title(4));
+        builder.setDate(std::to_string(gen.uniform(2000, 2016)) + "-06-01");
+        builder.setDuration(gen.uniform(10, 7200));
+        builder.setModificationTime(1400000000 + i);
+        store.insert(builder.build());
+    }
+}
+
+void use_synthetic_library(int size)
+{
+    const char *cache = getenv("MEDIASCANNER_BENCH_CACHE");
+    const std::string dir = std::string(cache ? cache : "/tmp") + "/mediascanner-bench-" + std::to_string(size);
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+    {
+        throw std::runtime_error(dir + ": " + strerror(errno));
+    }
+    if (setenv("MEDIASCANNER_CACHEDIR", dir.c_str(), 1) < 0)
+    {
+        throw std::runtime_error(strerror(errno));
+    }
+
+    // the marker is only written once the library is complete
+    const std::string marker = dir + "/synthetic-library-complete";
+    if (std::ifstream(marker).good())
+    {
+        return;
+    }
+    std::cerr << "Generating synthetic library of " << size << " tracks and videos in " << dir << std::endl;
+    // in a child process, so that the memory it takes doesn't show in the peak RSS of the benchmark
+    std::cerr.flush();
+    const pid_t child = fork();
+    if (child < 0)
+    {
+        throw std::runtime_error(std::string("fork: ") + strerror(errno));
+    }
+    if (child == 0)
+    {
+        try
+        {
+            {
+                MediaStore store(MS_READ_WRITE);
+                populate_synthetic_library(store, size, size);
+            }
+            std::ofstream(marker) << size << std::endl;
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "Failed to generate synthetic library: " << e.what() << std::endl;
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        throw std::runtime_error("Generating the synthetic library of " + std::to_string(size) + " failed");
+    }
+}
+
+std::vector<int> synthetic_library_sizes()
+{
+    const char *sizes = getenv("MEDIASCANNER_BENCH_SIZES");
+    return parse_sizes(sizes ? sizes : "1000,10000,100000,1000000");
+}
+
+int benchmark_iterations(int fallback)
+{
+    const char *iterations = getenv("MEDIASCANNER_BENCH_ITERATIONS");
+    const int value = iterations ? atoi(iterations) : 0;
+    return value > 0 ? value : fallback;
+}
+
+long peak_rss_kb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+    {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+std::string percentiles(std::vector<double> timings, char const* unit)
+{
+    if (timings.empty())
+    {
+        return "no samples";
+    }
+    std::sort(timings.begin(), timings.end());
+    auto const at = [&timings](double p) {
+        return timings[std::min(timings.size() - 1, static_cast<std::size_t>(p * timings.size()))];
+    };
+    char text[128];
+    snprintf(text, sizeof(text), "p50 %8.2f %s  p95 %8.2f %s  p99 %8.2f %s",
+             at(0.50), unit, at(0.95), unit, at(0.99), unit);
+    return text;
+}
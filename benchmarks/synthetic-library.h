@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SYNTHETICLIBRARY_H_
+#define SYNTHETICLIBRARY_H_
+
+#include <mediascanner/MediaStore.hh>
+
+#include <string>
+#include <vector>
+
+/*
+   Fills a media store with a reproducible library of 'tracks' songs and
+   'videos' videos. Artist popularity and genres follow a skewed distribution,
+   albums have 8 to 14 tracks and about a third of the videos come from the camera.
+*/
+void populate_synthetic_library(mediascanner::MediaStore& store, int tracks, int videos);
+
+/*
+   Points MEDIASCANNER_CACHEDIR at a store holding a synthetic library of the given size.
+   The store is generated on first use and kept in MEDIASCANNER_BENCH_CACHE (or /tmp)
+   for later runs, as generating the large ones takes a while. It is generated in a
+   child process and doesn't add to peak_rss_kb().
+*/
+void use_synthetic_library(int size);
+
+// library sizes from MEDIASCANNER_BENCH_SIZES (comma separated), by default 1k, 10k, 100k and 1M
+std::vector<int> synthetic_library_sizes();
+
+// iterations per measurement from MEDIASCANNER_BENCH_ITERATIONS, by default 'fallback'
+int benchmark_iterations(int fallback);
+
+// words the synthetic titles are made of, for building queries that match something
+extern const std::vector<std::string> synthetic_words;
+extern const std::vector<std::string> synthetic_genres;
+// the artist with the most albums
+extern const std::string synthetic_top_artist;
+
+// peak resident set size of this process in kB
+long peak_rss_kb();
+
+// formats the 50th, 95th and 99th percentile of the given timings, which are in 'unit'
+std::string percentiles(std::vector<double> timings, char const* unit = "ms");
+
+#endif
@@ -23,6 +23,11 @@
 #include "musicaggregatorscope.h"
 #include "../utils/i18n.h"
 #include "../utils/bufferedresultforwarder.h"
+#include "../utils/metrics.h"
+#include "../utils/tracing.h"
+#ifdef LOCAL_SCOPES_IN_PROCESS
+#include "../mymusic/music-scope.h"
+#endif
 #include <memory>
 #include <map>
 #include <mutex>
@@ -190,22 +195,42 @@ static char YOUTUBE_SEARCH_CATEGORY_DEFINITION[] = R"(
 )";
 
 MusicAggregatorQuery::MusicAggregatorQuery(CannedQuery const& query, SearchMetadata const& hints,
-        ChildScopeList const& scopes
+        ChildScopeList const& scopes, std::shared_ptr<MusicScope> const& local_scope, std::size_t early_results
         ) :
     SearchQueryBase(query, hints),
-    child_scopes(scopes)
+    child_scopes(scopes),
+    local_scope(local_scope),
+    early_results(early_results),
+    local_cancelled(false)
 {
     std::reverse(child_scopes.begin(), child_scopes.end());
 }
 
 MusicAggregatorQuery::~MusicAggregatorQuery() {
+    if (local_thread.joinable())
+    {
+        local_thread.join();
+    }
 }
 
 void MusicAggregatorQuery::cancelled() {
+    static Counter& cancellations = metrics::counter("mediascanner_queries_cancelled_total", "scope=\"musicaggregator\"");
+    cancellations.inc();
+    subsearches.cancel();
+
+    local_cancelled = true;
+    std::lock_guard<std::mutex> lock(local_mutex);
+    if (local_query)
+    {
+        local_query->cancelled();
+    }
 }
 
 void MusicAggregatorQuery::run(unity::scopes::SearchReplyProxy const& parent_reply)
 {
+    TraceSpan span("MusicAggregatorQuery::run");
+    static Counter& queries = metrics::counter("mediascanner_queries_total", "scope=\"musicaggregator\"");
+    queries.inc();
     std::vector<unity::scopes::utility::BufferedResultForwarder::SPtr> replies;
     ChildScopeList scopes;
     const std::string department_id = "aggregated:musicaggregator";
@@ -332,7 +357,17 @@ void MusicAggregatorQuery::run(unity::scopes::SearchReplyProxy const& parent_rep
         }
     }
 
+    auto const timer = std::make_shared<FirstResultTimer>("musicaggregator", early_results > 0 ? "interleaved" : "ordered");
+    for (unsigned int i = 0; i < replies.size(); ++i)
+    {
+        auto const forwarder = std::static_pointer_cast<BufferedResultForwarder>(replies[i]);
+        forwarder->set_early_results(early_results);
+        forwarder->set_first_result_timer(timer);
+        forwarder->set_child_metrics("musicaggregator", scopes[i].id);
+    }
+
     // dispatch search to subscopes
+    std::function<void()> local_search;
     for (unsigned int i = 0; i < replies.size(); ++i)
     {
         std::string dept;
@@ -381,6 +416,64 @@ void MusicAggregatorQuery::run(unity::scopes::SearchReplyProxy const& parent_rep
             metadata.set_location(Location(0, 0));
         }
 
-        subsearch(scopes[i], query().query_string(), dept, FilterState(), metadata, replies[i]);
+        if (local_scope && scopes[i].id == MusicAggregatorScope::LOCALSCOPE)
+        {
+            // search local music in this process once the other subsearches are on their way
+            auto const child = scopes[i];
+            auto const reply = replies[i];
+            local_search = [this, child, metadata, reply, parent_reply]() {
+                search_in_process(child, metadata, reply, parent_reply);
+            };
+            continue;
+        }
+
+        // identical subsearches of concurrent queries (e.g. when the dash gets reopened) share one child query
+        auto const child = scopes[i];
+        auto const query_string = query().query_string();
+        subsearches.subsearch(child, query_string, dept, metadata, replies[i],
+            [this, child, query_string, dept, metadata](SearchListenerBase::SPtr const& listener) {
+                return subsearch(child, query_string, dept, FilterState(), metadata, listener);
+            });
+    }
+
+    if (local_search)
+    {
+        local_thread = std::thread(local_search);
+    }
+}
+
+void MusicAggregatorQuery::search_in_process(ChildScope const& child, SearchMetadata const& metadata,
+        SearchListenerBase::SPtr const& reply, SearchReplyProxy const& parent_reply)
+{
+#ifdef LOCAL_SCOPES_IN_PROCESS
+    TraceSpan span("MusicAggregatorQuery::search_in_process");
+    SearchMetadata local_metadata(metadata);
+    local_metadata.set_aggregated_keywords(child.keywords);
+
+    // categories get registered directly with the parent reply, results go through the forwarder
+    // so that they keep their position in the aggregated output
+    auto const local = std::make_shared<MusicQuery>(*local_scope, CannedQuery(child.id, query().query_string(), ""), local_metadata);
+    {
+        // cancelled() reaches the local query from now on
+        std::lock_guard<std::mutex> lock(local_mutex);
+        if (local_cancelled)
+        {
+            reply->finished(CompletionDetails(CompletionDetails::Cancelled));
+            return;
+        }
+        local_query = local;
+    }
+    try
+    {
+        local->run_in_process(parent_reply, [this, &reply](CategorisedResult const& result) -> bool {
+                reply->push(result);
+                return valid() && !local_cancelled;
+            });
+        reply->finished(CompletionDetails(local_cancelled ? CompletionDetails::Cancelled : CompletionDetails::OK));
+    }
+    catch (const std::exception& e)
+    {
+        reply->finished(CompletionDetails(CompletionDetails::Error, e.what()));
     }
+#endif
 }
@@ -24,21 +24,46 @@
 #include <unity/scopes/Category.h>
 #include <unity/scopes/ReplyProxyFwd.h>
 
+#include "../utils/inflightsearches.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 class ResultForwarder;
+class MusicScope;
 
 class MusicAggregatorQuery : public unity::scopes::SearchQueryBase
 {
 public:
     MusicAggregatorQuery(unity::scopes::CannedQuery const& query,
             unity::scopes::SearchMetadata const& hints,
-            unity::scopes::ChildScopeList const& scopes);
+            unity::scopes::ChildScopeList const& scopes,
+            std::shared_ptr<MusicScope> const& local_scope = nullptr,
+            std::size_t early_results = 0);
     ~MusicAggregatorQuery();
     virtual void cancelled() override;
 
     virtual void run(unity::scopes::SearchReplyProxy const& reply) override;
 
 private:
+    void search_in_process(unity::scopes::ChildScope const& child,
+            unity::scopes::SearchMetadata const& metadata,
+            unity::scopes::SearchListenerBase::SPtr const& reply,
+            unity::scopes::SearchReplyProxy const& parent_reply);
+
     unity::scopes::ChildScopeList child_scopes;
+    // kept here, so that the local query outlives a stop() of the aggregator
+    std::shared_ptr<MusicScope> local_scope;
+    std::size_t early_results;
+    CoalescedSearches subsearches;
+
+    // the in-process local query runs on a thread of its own, so that run() doesn't wait for it
+    std::thread local_thread;
+    std::mutex local_mutex;
+    std::shared_ptr<unity::scopes::SearchQueryBase> local_query;
+    std::atomic<bool> local_cancelled;
 };
 
 #endif
@@ -25,6 +25,13 @@
 #include <unity/scopes/CategoryRenderer.h>
 #include "../utils/utils.h"
 #include "../utils/i18n.h"
+#include "../utils/firstresulttimer.h"
+#include "../utils/metrics.h"
+#include "../utils/tracing.h"
+#include <iostream>
+#ifdef LOCAL_SCOPES_IN_PROCESS
+#include "../mymusic/music-scope.h"
+#endif
 
 using namespace unity::scopes;
 
@@ -49,14 +56,34 @@ const std::vector<std::string> predefined_scopes {
 
 void MusicAggregatorScope::start(std::string const&) {
     init_gettext(*this);
+    early_results = aggregator_early_results();
+    metrics::start_export();
+#ifdef LOCAL_SCOPES_IN_PROCESS
+    try
+    {
+        auto const dir = registry()->get_metadata(LOCALSCOPE).scope_directory();
+        local_scope = std::make_shared<MusicScope>();
+        local_scope->start_in_process(dir);
+    }
+    catch (const std::exception& e)
+    {
+        // fall back to querying the local scope over IPC
+        std::cerr << "Failed to start " << LOCALSCOPE << " in process: " << e.what() << std::endl;
+        local_scope.reset();
+    }
+#endif
 }
 
 void MusicAggregatorScope::stop() {
+    local_scope.reset();
+    FirstResultTimer::log_summary(std::cerr, "musicaggregator");
+    metrics::stop_export();
+    flush_trace();
 }
 
 SearchQueryBase::UPtr MusicAggregatorScope::search(CannedQuery const& q,
                                                    SearchMetadata const& hints) {
-    SearchQueryBase::UPtr query(new MusicAggregatorQuery(q, hints, child_scopes()));
+    SearchQueryBase::UPtr query(new MusicAggregatorQuery(q, hints, child_scopes(), local_scope, early_results));
     return query;
 }
 
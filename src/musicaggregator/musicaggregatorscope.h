@@ -26,6 +26,10 @@
 #include <unity/scopes/ReplyProxyFwd.h>
 #include <unity/scopes/Variant.h>
 
+#include <memory>
+
+class MusicScope;
+
 class MusicAggregatorScope : public unity::scopes::ScopeBase
 {
 public:
@@ -46,6 +50,12 @@ public:
             unity::scopes::SearchMetadata const& hints) override;
 
     virtual unity::scopes::ChildScopeList find_child_scopes() const override;
+
+private:
+    // local music scope running in this process, if LOCAL_SCOPES_IN_PROCESS is enabled
+    std::shared_ptr<MusicScope> local_scope;
+    // results each child may show ahead of its turn, 0 for strictly ordered output
+    std::size_t early_results = 0;
 };
 
 #endif
@@ -19,6 +19,7 @@
 #include <config.h>
 #include <iostream>
 #include <algorithm>
+#include <map>
 #include <gio/gio.h>
 
 #include <mediascanner/MediaFile.hh>
@@ -37,9 +38,25 @@
 
 #include "music-scope.h"
 #include "../utils/i18n.h"
+#include "../utils/mediadb.h"
+#include "../utils/metrics.h"
+#include "../utils/reorderbuffer.h"
+#include "../utils/searchkey.h"
+#include "../utils/storecall.h"
+#include "../utils/tracing.h"
+#include "../utils/urlescape.h"
+#include "../utils/utils.h"
 
 #define MAX_RESULTS 100
 #define MAX_GENRES 100
+// search strings up to this long are still being typed; their songs come from the key column
+#define MAX_TYPE_AHEAD_LENGTH 2
+// longer albums aren't embedded in their results, their preview looks the tracks up
+#define MAX_EMBEDDED_TRACKS 30
+// songs in the inline playback playlist of a song card, the ones around it
+#define PLAYLIST_WINDOW 20
+// of which this many come before it
+#define PLAYLIST_WINDOW_BEFORE 5
 
 static const char THUMBNAILER_SCHEMA[] = "com.canonical.Unity.Thumbnailer";
 static const char THUMBNAILER_API_KEY[] = "dash-ubuntu-com-key";
@@ -214,15 +231,66 @@ using namespace unity::scopes;
 using namespace core::net;
 namespace json = Json;
 
+// the "tracks" attribute of an album preview's audio widget
+static Variant make_album_tracks(std::vector<MediaFile> const& album_songs)
+{
+    VariantBuilder builder;
+    for(const auto &track : album_songs) {
+        std::vector<std::pair<std::string, Variant>> tmp;
+        tmp.emplace_back("title", Variant(track.getTitle()));
+        tmp.emplace_back("source", Variant(track.getUri()));
+        tmp.emplace_back("length", Variant(track.getDuration()));
+        builder.add_tuple(tmp);
+    }
+    return builder.end();
+}
+
 void MusicScope::start(std::string const&) {
     init_gettext(*this);
-    store.reset(new MediaStore(MS_READ_ONLY));
-    client = http::make_client();
-    set_api_key();
+    directory = scope_directory();
+    open();
+    metrics::start_export();
+}
+
+void MusicScope::start_in_process(std::string const& scope_dir) {
+    directory = scope_dir;
+    open();
+}
+
+void MusicScope::open() {
+    const std::size_t worker_threads = query_workers();
+    stores = std::make_shared<StorePool>("music", store_connections(worker_threads));
+    // taken once a search needs correcting
+    catalogue.reset(new MediaCatalogueCache(AudioMedia));
+    key_column.reset(new MediaKeyColumnCache(AudioMedia));
+    fuzzy_search = fuzzy_search_enabled();
+    type_ahead.reset(type_ahead_enabled() ? new TypeAheadCache("music") : nullptr);
+    results.reset(result_cache_enabled() ? new ResultCache("music") : nullptr);
+    album_tracks.reset(new AlbumTracksCache());
+    artist_art.reset(new ArtistArtCache());
+    embedded_albums = embedded_album_tracks();
+    unified_search = unified_search_enabled();
+    workers.reset(worker_threads > 0 ? new WorkerPool(worker_threads) : nullptr);
+}
+
+http::Client& MusicScope::http_client() const
+{
+    std::lock_guard<std::mutex> lock(lazy_mutex);
+    if (!client)
+    {
+        client = http::make_client();
+    }
+    return *client;
 }
 
-void MusicScope::set_api_key()
+std::string const& MusicScope::get_api_key() const
 {
+    std::lock_guard<std::mutex> lock(lazy_mutex);
+    if (api_key_loaded)
+    {
+        return api_key;
+    }
+    api_key_loaded = true;
     // the API key is not expected to change, so don't monitor it
     GSettingsSchemaSource *src = g_settings_schema_source_get_default();
     GSettingsSchema *schema = g_settings_schema_source_lookup(src, THUMBNAILER_SCHEMA, true);
@@ -247,10 +315,18 @@ void MusicScope::set_api_key()
     } else {
         std::cerr << "The schema " << THUMBNAILER_SCHEMA << " is missing" << std::endl;
     }
+    return api_key;
 }
 
 void MusicScope::stop() {
-    store.reset();
+    // the queries still running hold on to these, the last one to finish lets go
+    // of them, waiting for the workers and for snapshots still being taken
+    workers.reset();
+    catalogue.reset();
+    key_column.reset();
+    stores.reset();
+    metrics::stop_export();
+    flush_trace();
 }
 
 SearchQueryBase::UPtr MusicScope::search(CannedQuery const &q,
@@ -266,22 +342,155 @@ PreviewQueryBase::UPtr MusicScope::preview(Result const& result,
 }
 
 std::string MusicScope::make_artist_art_uri(const std::string &artist, const std::string &album) const {
-    auto const uri = core::net::make_uri(
-            "image://artistart", {}, {{"artist", artist}, {"album", album}});
-    return client->uri_to_string(uri);
+    TraceSpan span("MusicScope::make_artist_art_uri");
+    return artist_art->get(artist, album);
 }
 
 MusicQuery::MusicQuery(MusicScope &scope, CannedQuery const& query, SearchMetadata const& hints)
     : SearchQueryBase(query, hints),
       scope(scope),
-      query_cancelled(false) {
+      stores(scope.stores),
+      workers(scope.workers),
+      catalogue(scope.catalogue),
+      key_column(scope.key_column),
+      query_cancelled(false),
+      search_string(query.query_string()) {
 }
 
 void MusicQuery::cancelled() {
+    static Counter& cancellations = metrics::counter("mediascanner_queries_cancelled_total", "scope=\"music\"");
+    cancellations.inc();
     query_cancelled = true;
 }
 
+void MusicQuery::run_in_process(SearchReplyProxy const&reply, std::function<bool(CategorisedResult const&)> const& sink) {
+    this->sink = sink;
+    run(reply);
+}
+
+// the connection of the sub-query running on the calling worker, see run_concurrently()
+static thread_local MediaStore const* subquery_store = nullptr;
+
+struct SubqueryStore
+{
+    explicit SubqueryStore(MediaStore const& store)
+    {
+        subquery_store = &store;
+    }
+    ~SubqueryStore()
+    {
+        subquery_store = nullptr;
+    }
+};
+
+MediaStore const& MusicQuery::store() const {
+    return subquery_store ? *subquery_store : *connection;
+}
+
+bool MusicQuery::push(SearchReplyProxy const& reply, CategorisedResult const& result) const {
+    if (auto lane = ReorderBuffer::current_lane())
+    {
+        // a sub-query running on a worker, run_concurrently() pushes its results in order
+        return lane->push(result);
+    }
+    TraceSpan span("MusicQuery::push");
+    static Counter& pushed = metrics::counter("mediascanner_results_pushed_total", "scope=\"music\"");
+    static Counter& rejected = metrics::counter("mediascanner_push_rejected_total", "scope=\"music\"");
+    const bool accepted = sink ? sink(result) : reply->push(result);
+    (accepted ? pushed : rejected).inc();
+    pushed_results++;
+    if (!accepted)
+    {
+        // the results after this one are missing, so the query can't be replayed
+        recording.reset();
+    }
+    else if (recording)
+    {
+        recording->results.push_back(result);
+    }
+    return accepted;
+}
+
+// coarse kinds of query, for the query counters
+static const char* const QUERY_CLASSES[] = {
+    "aggregated", "tracks", "albums", "genres", "genre", "artist", "surfacing", "search"
+};
+
+// index of the query's kind in QUERY_CLASSES
+static std::size_t query_class(CannedQuery const& query, bool is_aggregated)
+{
+    auto const department = query.department_id();
+    if (is_aggregated)
+    {
+        return 0;
+    }
+    for (std::size_t i: {1, 2, 3})
+    {
+        if (department == QUERY_CLASSES[i])
+        {
+            return i;
+        }
+    }
+    if (department.find("genre:") == 0)
+    {
+        return 4;
+    }
+    if (query.has_user_data() && query.user_data().get_string() == "albums_of_artist")
+    {
+        return 5;
+    }
+    return query.query_string().empty() ? 6 : 7;
+}
+
+// the query counters are looked up once, not on every query
+static Counter& queries_total(std::size_t query_class)
+{
+    static const std::vector<Counter*> counters = [] {
+        std::vector<Counter*> counters;
+        for (auto const name: QUERY_CLASSES)
+        {
+            counters.push_back(&metrics::counter("mediascanner_queries_total",
+                    std::string("scope=\"music\",department=\"") + name + "\""));
+        }
+        return counters;
+    }();
+    return *counters[query_class];
+}
+
 void MusicQuery::run(SearchReplyProxy const&reply) {
+    TraceSpan span("MusicQuery::run");
+    static Histogram& latency = metrics::histogram("mediascanner_query_seconds", "scope=\"music\"");
+    ScopedLatency query_latency(latency);
+    queries_total(query_class(query(), search_metadata().is_aggregated())).inc();
+    generation = media_db_generation();
+
+    if (!scope.results || uses_network())
+    {
+        run_search(reply);
+        return;
+    }
+    auto const key = ResultCache::make_key(query(), search_metadata());
+    if (auto const cached = scope.results->get(key, generation))
+    {
+        ResultCache::replay(*cached, reply, [this, &reply](CategorisedResult const& result) {
+            return push(reply, result);
+        });
+        return;
+    }
+
+    recording = std::make_shared<ResultCache::Entry>();
+    recording->generation = generation;
+    run_search(reply);
+    if (recording && !query_cancelled)
+    {
+        scope.results->insert(key, recording);
+    }
+    recording.reset();
+}
+
+void MusicQuery::run_search(SearchReplyProxy const&reply) {
+    // replayed queries don't get this far, so they don't take a connection
+    connection = stores->checkout();
     const bool empty_search_query = query().query_string().empty();
     const bool is_aggregated = search_metadata().is_aggregated();
 
@@ -303,14 +512,32 @@ void MusicQuery::run(SearchReplyProxy const&reply) {
                 "mymusic", _("My Music"), "",
                 CannedQuery(query().scope_id(), query().query_string(), ""),
                 renderer);
-            query_artists(reply, cat);
-            query_albums(reply, cat);
-            query_songs(reply, cat);
+            search_with_correction([&] {
+                    find_matches();
+                    if (matches && matches->grouped)
+                    {
+                        query_artists(reply, cat);
+                        query_albums(reply, cat);
+                        query_songs(reply, cat);
+                    }
+                    else
+                    {
+                        run_concurrently(reply, {
+                                [&] { query_artists(reply, cat); },
+                                [&] { query_albums(reply, cat); },
+                                [&] { query_songs(reply, cat); }});
+                    }
+                });
         }
         return;
     }
 
-    if (!scope.store->hasMedia(AudioMedia))
+    bool has_media;
+    {
+        STORE_CALL("music", "MediaStore::hasMedia");
+        has_media = store().hasMedia(AudioMedia);
+    }
+    if (!has_media)
     {
         const CategoryRenderer renderer(GET_STARTED_CATEGORY_DEFINITION);
         auto cat = reply->register_category("mymusic-getstarted", "", "", renderer);
@@ -318,8 +545,8 @@ void MusicQuery::run(SearchReplyProxy const&reply) {
         res.set_uri(query().to_uri());
         res.set_title(_("Get started!"));
         res["summary"] = _("Drag and drop items from another devices. Alternatively, load your files onto a SD card.");
-        res.set_art(scope.scope_directory() + "/" + "getstarted.svg");
-        reply->push(res);
+        res.set_art(scope.directory + "/" + "getstarted.svg");
+        push(reply, res);
         return;
     }
 
@@ -328,11 +555,13 @@ void MusicQuery::run(SearchReplyProxy const&reply) {
     auto const current_department = query().department_id();
     if (current_department == "tracks")
     {
-        query_songs(reply);
+        auto const songs = songs_category(reply);
+        search_with_correction([&] { query_songs(reply, songs); });
     }
     else if (current_department == "albums")
     {
-        query_albums(reply);
+        auto const albums = albums_category(reply);
+        search_with_correction([&] { query_albums(reply, albums); });
     }
     else if (current_department == "genres")
     {
@@ -347,8 +576,15 @@ void MusicQuery::run(SearchReplyProxy const&reply) {
     else if (query().has_user_data() && query().user_data().get_string() == "albums_of_artist")
     {
         const std::string artist = query().query_string();
-        query_albums_by_artist(reply, artist);
-        query_songs_by_artist(reply, artist);
+        // the categories go first, in the order the results come in
+        auto const biocat = reply->register_category("bio", "", "", make_renderer(ARTIST_BIO_CATEGORY_DEFINITION, MISSING_ALBUM_ART));
+        auto const albumcat = reply->register_category("albums", _("Albums"), SONGS_CATEGORY_ICON,
+                make_renderer(ALBUMS_CATEGORY_DEFINITION, MISSING_ALBUM_ART));
+        auto const songcat = reply->register_category("songs", _("Tracks"), SONGS_CATEGORY_ICON,
+                make_renderer(artist.empty() ? SONGS_CATEGORY_DEFINITION : SEARCH_SONGS_CATEGORY_DEFINITION, MISSING_ALBUM_ART));
+        run_concurrently(reply, {
+                [&] { query_albums_by_artist(reply, artist, biocat, albumcat); },
+                [&] { query_songs_by_artist(reply, artist, songcat); }});
     }
     else // empty department id - default view
     {
@@ -358,26 +594,138 @@ void MusicQuery::run(SearchReplyProxy const&reply) {
         }
         else // non-empty search in albums and songs
         {
-            query_artists(reply);
-            query_albums(reply);
-            query_songs(reply);
+            auto const artists = artists_category(reply);
+            auto const albums = albums_category(reply);
+            auto const songs = songs_category(reply);
+            search_with_correction([&] {
+                    find_matches();
+                    if (matches && matches->grouped)
+                    {
+                        query_artists(reply, artists);
+                        query_albums(reply, albums);
+                        query_songs(reply, songs);
+                    }
+                    else
+                    {
+                        run_concurrently(reply, {
+                                [&] { query_artists(reply, artists); },
+                                [&] { query_albums(reply, albums); },
+                                [&] { query_songs(reply, songs); }});
+                    }
+                });
         }
     }
 }
 
+void MusicQuery::run_concurrently(SearchReplyProxy const& reply, std::vector<std::function<void()>> const& subqueries) const
+{
+    if (!workers)
+    {
+        for (auto const& subquery: subqueries)
+        {
+            subquery();
+        }
+        return;
+    }
+
+    TraceSpan span("MusicQuery::run_concurrently");
+    ReorderBuffer buffer(subqueries.size());
+    std::vector<std::future<void>> done;
+    done.reserve(subqueries.size());
+    try
+    {
+        for (std::size_t i = 0; i < subqueries.size(); i++)
+        {
+            done.push_back(workers->submit([this, &buffer, &subqueries, i] {
+                        ReorderBuffer::Lane lane(buffer, i);
+                        // the first sub-query borrows the query's connection, which is idle while the
+                        // query waits for the results; the others check one out of the pool
+                        StorePool::Handle own = i > 0 ? stores->checkout() : StorePool::Handle();
+                        SubqueryStore store(i > 0 ? *own : *connection);
+                        subqueries[i]();
+                    }));
+        }
+        buffer.drain([this, &reply](CategorisedResult const& result) {
+                return push(reply, result);
+            });
+    }
+    catch (...)
+    {
+        // the sub-queries submitted so far refer to the buffer and the query, so they
+        // have to be done before either goes; rejecting their results lets them finish
+        buffer.reject();
+        for (auto& subquery: done)
+        {
+            subquery.wait();
+        }
+        throw;
+    }
+    // the sub-queries still refer to the buffer, and pass on what they threw
+    for (auto& subquery: done)
+    {
+        subquery.wait();
+    }
+    for (auto& subquery: done)
+    {
+        subquery.get();
+    }
+}
+
 CategoryRenderer MusicQuery::make_renderer(std::string json_text, std::string const& fallback) const {
     static std::string const placeholder("@FALLBACK@");
     size_t pos = json_text.find(placeholder);
     if (pos != std::string::npos)
     {
-        json_text.replace(pos, placeholder.size(), scope.scope_directory() + "/" + fallback);
+        json_text.replace(pos, placeholder.size(), scope.directory + "/" + fallback);
     }
     return CategoryRenderer(json_text);
 }
 
 
+bool MusicQuery::correct_search_string()
+{
+    TraceSpan span("MusicQuery::correct_search_string");
+    // still being typed, the key column already matched it regardless of case and diacritics
+    if (search_key(search_string).size() <= MAX_TYPE_AHEAD_LENGTH)
+    {
+        return false;
+    }
+    // the closest name has to be among the names in the database now
+    auto const snapshot = catalogue->wait();
+    std::string correction;
+    if (snapshot)
+    {
+        // without fuzzy search, only case and diacritics get corrected
+        correction = scope.fuzzy_search ? snapshot->closest_match(store(), search_string)
+                                        : snapshot->name_containing(store(), search_string);
+    }
+    if (correction.empty() || correction == search_string)
+    {
+        return false;
+    }
+    static Counter& corrected = metrics::counter("mediascanner_queries_corrected_total", "scope=\"music\"");
+    corrected.inc();
+    search_string = correction;
+    return true;
+}
+
+void MusicQuery::search_with_correction(std::function<void()> const& search)
+{
+    const std::size_t pushed = pushed_results;
+    search();
+    // only a search that found nothing pays for the correction, so that "motorhead" finds
+    // Motörhead, and with fuzzy search "beatels" The Beatles
+    if (pushed_results == pushed && !query_cancelled && !search_string.empty()
+        && correct_search_string())
+    {
+        matches.reset();
+        search();
+    }
+}
+
 void MusicQuery::populate_departments(unity::scopes::SearchReplyProxy const &reply) const
 {
+    TraceSpan span("MusicQuery::populate_departments");
     unity::scopes::Department::SPtr artists = unity::scopes::Department::create("", query(), _("Artists"));
     unity::scopes::Department::SPtr albums = unity::scopes::Department::create("albums", query(), _("Albums"));
     unity::scopes::Department::SPtr tracks = unity::scopes::Department::create("tracks", query(), _("Tracks"));
@@ -388,7 +736,12 @@ void MusicQuery::populate_departments(unity::scopes::SearchReplyProxy const &rep
     if (current_department == "genres" || current_department.find("genre:") == 0)
     {
         const mediascanner::Filter filter;
-        for (const auto &genre: scope.store->listGenres(filter))
+        std::vector<std::string> genre_names;
+        {
+            STORE_CALL("music", "MediaStore::listGenres");
+            genre_names = store().listGenres(filter);
+        }
+        for (const auto &genre: genre_names)
         {
             if (!genre.empty())
             {
@@ -403,6 +756,10 @@ void MusicQuery::populate_departments(unity::scopes::SearchReplyProxy const &rep
 
     artists->set_subdepartments({albums, genres, tracks});
 
+    if (recording)
+    {
+        recording->departments = artists;
+    }
     try
     {
         reply->register_departments(artists);
@@ -413,12 +770,116 @@ void MusicQuery::populate_departments(unity::scopes::SearchReplyProxy const &rep
     }
 }
 
+void MusicQuery::find_matches()
+{
+    const std::string key = search_key(search_string);
+    // short searches scan the key column for their songs rather than the index, once it is taken
+    if (!scope.unified_search || (key.size() <= MAX_TYPE_AHEAD_LENGTH && key_column->get()))
+    {
+        return;
+    }
+    TraceSpan span("MusicQuery::find_matches");
+
+    // grouped the way queryArtists() and queryAlbums() group them, which is also their
+    // order: artists by name, albums by title and then album artist
+    auto const group = [](std::vector<MediaFile> const& candidates) {
+        std::unique_ptr<Matches> found(new Matches);
+        found->grouped = true;
+        std::map<std::string, std::string> artists;
+        std::map<std::pair<std::string, std::string>, MediaFile const*> albums;
+        for (auto const& media: candidates)
+        {
+            if (!media.getAuthor().empty())
+            {
+                auto& album = artists[media.getAuthor()];
+                if (album.empty())
+                {
+                    album = media.getAlbum();
+                }
+            }
+            if (!media.getAlbum().empty())
+            {
+                albums.emplace(std::make_pair(media.getAlbum(), media.getAlbumArtist()), &media);
+            }
+        }
+        for (auto const& artist: artists)
+        {
+            if (found->artists.size() == MAX_RESULTS)
+            {
+                break;
+            }
+            found->artists.emplace_back(artist.first, artist.second);
+        }
+        for (auto const& album: albums)
+        {
+            if (found->albums.size() == MAX_RESULTS)
+            {
+                break;
+            }
+            MediaFile const& media = *album.second;
+            found->albums.emplace_back(media.getAlbum(), media.getAlbumArtist(), media.getDate(), media.getGenre(),
+                                       media.getFileName(), media.getHasThumbnail());
+        }
+        return found;
+    };
+
+    // typing on from an earlier search that found every song it matched needs no store query
+    bool complete = false;
+    auto const refined = scope.type_ahead ? scope.type_ahead->refine(search_string, generation, &complete)
+                                          : TypeAheadCache::Candidates();
+    if (refined)
+    {
+        matches = complete ? group(*refined) : std::unique_ptr<Matches>(new Matches);
+        matches->songs = refined;
+        return;
+    }
+
+    mediascanner::Filter filter;
+    filter.setLimit(MAX_RESULTS);
+    std::vector<MediaFile> songs;
+    {
+        STORE_CALL("music", "MediaStore::query");
+        songs = store().query(search_string, AudioMedia, filter);
+    }
+    // the songs of a search matching more of them still get pushed, but its artists and
+    // albums come from separate queries, the ones of the songs past the limit would be missing
+    complete = songs.size() < MAX_RESULTS;
+    std::unique_ptr<Matches> found = complete ? group(songs) : std::unique_ptr<Matches>(new Matches);
+    found->songs = scope.type_ahead ? scope.type_ahead->insert(search_string, generation, std::move(songs), complete)
+                                    : std::make_shared<const std::vector<MediaFile>>(std::move(songs));
+    matches = std::move(found);
+}
+
+std::string MusicQuery::first_album_of(std::string const& artist) const
+{
+    mediascanner::Filter filter;
+    filter.setArtist(artist);
+    std::vector<Album> albums;
+    {
+        STORE_CALL("music", "MediaStore::listAlbums");
+        albums = store().listAlbums(filter);
+    }
+    for (auto const& album: albums)
+    {
+        if (!album.getTitle().empty())
+        {
+            return album.getTitle();
+        }
+    }
+    return std::string();
+}
+
 void MusicQuery::query_genres(unity::scopes::SearchReplyProxy const&reply) const
 {
+    TraceSpan span("MusicQuery::query_genres");
     const CategoryRenderer renderer = make_renderer(ALBUMS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
     mediascanner::Filter filter;
 
-    auto const genres = scope.store->listGenres(filter);
+    std::vector<std::string> genres;
+    {
+        STORE_CALL("music", "MediaStore::listGenres");
+        genres = store().listGenres(filter);
+    }
     auto const genre_limit = std::min(static_cast<int>(genres.size()), 10);
     int limit = MAX_RESULTS;
 
@@ -428,10 +889,15 @@ void MusicQuery::query_genres(unity::scopes::SearchReplyProxy const&reply) const
 
         filter.setGenre(genres[i]);
         filter.setLimit(limit);
-        for (const auto &album: scope.store->listAlbums(filter))
+        std::vector<Album> albums;
+        {
+            STORE_CALL("music", "MediaStore::listAlbums");
+            albums = store().listAlbums(filter);
+        }
+        for (const auto &album: albums)
         {
             limit--;
-            if (!reply->push(create_album_result(cat, album)))
+            if (!push(reply, create_album_result(cat, album)))
                 return;
         }
         if (limit <= 0)
@@ -441,15 +907,17 @@ void MusicQuery::query_genres(unity::scopes::SearchReplyProxy const&reply) const
     }
 }
 
-void MusicQuery::query_artists(unity::scopes::SearchReplyProxy const& reply, Category::SCPtr const& override_category) const
+Category::SCPtr MusicQuery::artists_category(unity::scopes::SearchReplyProxy const& reply) const
 {
     const bool show_title = !query().query_string().empty();
+    CategoryRenderer renderer = make_renderer(query().query_string() == "" ? ARTISTS_CATEGORY_DEFINITION : SEARCH_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
+    return reply->register_category("artists", show_title ? _("Artists") : "", SONGS_CATEGORY_ICON, renderer); //FIXME: icon
+}
 
-    auto cat = override_category;
-    if (!cat) {
-        CategoryRenderer renderer = make_renderer(query().query_string() == "" ? ARTISTS_CATEGORY_DEFINITION : SEARCH_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
-        cat = reply->register_category("artists", show_title ? _("Artists") : "", SONGS_CATEGORY_ICON, renderer); //FIXME: icon
-    }
+void MusicQuery::query_artists(unity::scopes::SearchReplyProxy const& reply, Category::SCPtr const& override_category) const
+{
+    TraceSpan span("MusicQuery::query_artists");
+    auto const cat = override_category ? override_category : artists_category(reply);
 
     CannedQuery artist_search(query());
     artist_search.set_department_id("");
@@ -457,8 +925,27 @@ void MusicQuery::query_artists(unity::scopes::SearchReplyProxy const& reply, Cat
 
     mediascanner::Filter filter;
     filter.setLimit(MAX_RESULTS);
-    for (const auto &artist: scope.store->queryArtists(query().query_string(), filter))
+    // the artists, with the album their art goes by once known
+    std::vector<std::pair<std::string, std::string>> artists;
+    if (matches && matches->grouped)
+    {
+        artists = matches->artists;
+    }
+    else
+    {
+        std::vector<std::string> names;
+        {
+            STORE_CALL("music", "MediaStore::queryArtists");
+            names = store().queryArtists(search_string, filter);
+        }
+        for (auto& name: names)
+        {
+            artists.emplace_back(std::move(name), std::string());
+        }
+    }
+    for (const auto &found: artists)
     {
+        auto const& artist = found.first;
         artist_search.set_query_string(artist);
         artist_search.set_user_data(Variant("albums_of_artist"));
 
@@ -466,37 +953,60 @@ void MusicQuery::query_artists(unity::scopes::SearchReplyProxy const& reply, Cat
         res.set_uri(artist_search.to_uri());
         res.set_title(artist);
 
-        // find first non-empty album of this artist, needed to get artist-art
+        // going by the first album of all of the artist's songs, or, from a single scan, of the
+        // matching ones; the two differ when the artist's first album has no matching song
+        res.set_art(scope.make_artist_art_uri(artist, matches && matches->grouped ? found.second : first_album_of(artist)));
+
+        if(!push(reply, res))
         {
-            std::string album_name;
-            mediascanner::Filter filter;
-            filter.setArtist(artist);
-            for (auto const& album: scope.store->listAlbums(filter))
-            {
-                album_name = album.getTitle();
-                if (!album_name.empty())
-                {
-                    break;
-                }
-            }
-            res.set_art(scope.make_artist_art_uri(artist, album_name));
+            return;
         }
+    }
+}
+
+TypeAheadCache::Candidates MusicQuery::search_songs(mediascanner::Filter const& filter) const
+{
+    const std::string key = search_key(search_string);
+    // until the key column of the database as it is now has been taken, short searches go to the store too
+    auto const column = key.size() <= MAX_TYPE_AHEAD_LENGTH ? key_column->get() : MediaKeyColumn::SCPtr();
+    if (column)
+    {
+        TraceSpan scan_span("MediaKeyColumn::media_containing");
+        return std::make_shared<const std::vector<MediaFile>>(column->media_containing(search_string, MAX_RESULTS));
+    }
 
-        if(!reply->push(res))
+    if (scope.type_ahead)
+    {
+        if (auto cached = scope.type_ahead->refine(search_string, generation))
         {
-            return;
+            return cached;
         }
     }
+    std::vector<MediaFile> songs;
+    {
+        STORE_CALL("music", "MediaStore::query");
+        songs = store().query(search_string, AudioMedia, filter);
+    }
+    if (!scope.type_ahead)
+    {
+        return std::make_shared<const std::vector<MediaFile>>(std::move(songs));
+    }
+    // a list cut off at the limit may be missing songs that a longer search would find
+    const bool complete = songs.size() < MAX_RESULTS;
+    return scope.type_ahead->insert(search_string, generation, std::move(songs), complete);
+}
+
+Category::SCPtr MusicQuery::songs_category(unity::scopes::SearchReplyProxy const& reply) const
+{
+    const bool surfacing = query().query_string().empty();
+    CategoryRenderer renderer = make_renderer(surfacing ? SONGS_CATEGORY_DEFINITION : SEARCH_SONGS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
+    return reply->register_category("songs", surfacing ? "" : _("Tracks"), SONGS_CATEGORY_ICON, renderer);
 }
 
 void MusicQuery::query_songs(unity::scopes::SearchReplyProxy const&reply, Category::SCPtr const& override_category, bool sortByMtime) const {
+    TraceSpan span("MusicQuery::query_songs");
     const bool surfacing = query().query_string().empty();
-    auto cat = override_category;
-    if (!cat)
-    {
-        CategoryRenderer renderer = make_renderer(surfacing ? SONGS_CATEGORY_DEFINITION : SEARCH_SONGS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
-        cat = reply->register_category("songs", surfacing ? "" : _("Tracks"), SONGS_CATEGORY_ICON, renderer);
-    }
+    auto const cat = override_category ? override_category : songs_category(reply);
     mediascanner::Filter filter;
     filter.setLimit(MAX_RESULTS);
     if (sortByMtime) {
@@ -504,13 +1014,25 @@ void MusicQuery::query_songs(unity::scopes::SearchReplyProxy const&reply, Catego
         filter.setReverse(true);
     }
 
-    auto const songs = scope.store->query(query().query_string(), AudioMedia, filter);
-    static const std::vector<mediascanner::MediaFile> empty_playlist;
-
-    for (const auto &media : songs) {
-        // Inline playback should only be used in surfacing mode.
-        // Attach the playlist with all songs to every card (same playlist for every card).
-        if(!reply->push(create_song_result(cat, media, surfacing, surfacing ? songs : empty_playlist)))
+    std::vector<MediaFile> listed;
+    TypeAheadCache::Candidates found;
+    if (surfacing)
+    {
+        STORE_CALL("music", "MediaStore::query");
+        listed = store().query(search_string, AudioMedia, filter);
+    }
+    else
+    {
+        found = matches ? matches->songs : search_songs(filter);
+    }
+    auto const& songs = found ? *found : listed;
+    // Inline playback should only be used in surfacing mode.
+    // Every card plays the songs around it, rather than carrying all of them.
+    const VariantArray playlist = surfacing ? make_playlist(songs) : VariantArray();
+
+    for (std::size_t i = 0; i < songs.size(); i++) {
+        Variant window = surfacing ? Variant(playlist_window(playlist, i)) : Variant();
+        if(!push(reply, create_song_result(cat, songs[i], surfacing, std::move(window))))
         {
             return;
         }
@@ -518,39 +1040,115 @@ void MusicQuery::query_songs(unity::scopes::SearchReplyProxy const&reply, Catego
 
 }
 
-void MusicQuery::query_songs_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist) const
+void MusicQuery::query_songs_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist, Category::SCPtr const& cat) const
 {
-    CategoryRenderer renderer = make_renderer(query().query_string() == "" ? SONGS_CATEGORY_DEFINITION : SEARCH_SONGS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
-    auto cat = reply->register_category("songs", _("Tracks"), SONGS_CATEGORY_ICON, renderer);
+    TraceSpan span("MusicQuery::query_songs_by_artist");
 
     mediascanner::Filter filter;
     filter.setArtist(artist);
     filter.setLimit(MAX_RESULTS);
 
-    for (const auto &media : scope.store->listSongs(filter)) {
-        if(!reply->push(create_song_result(cat, media)))
+    std::vector<MediaFile> songs;
+    {
+        STORE_CALL("music", "MediaStore::listSongs");
+        songs = store().listSongs(filter);
+    }
+    for (const auto &media : songs) {
+        if(!push(reply, create_song_result(cat, media)))
         {
             return;
         }
     }
 }
 
+std::string MusicQuery::make_album_uri(mediascanner::Album const& album) const
+{
+    auto const& artist = album.getArtist();
+    if (!escaped_artist_valid || escaped_artist_key != artist)
+    {
+        escaped_artist_key = artist;
+        escaped_artist = url_escape(artist);
+        escaped_artist_valid = true;
+    }
+    auto const& title = album.getTitle();
+
+    static const std::string prefix = "album:///";
+    std::string uri;
+    uri.reserve(prefix.size() + escaped_artist.size() + 1 + title.size());
+    uri.append(prefix).append(escaped_artist).append(1, '/');
+    append_url_escaped(uri, title);
+    return uri;
+}
+
 unity::scopes::CategorisedResult MusicQuery::create_album_result(unity::scopes::Category::SCPtr const& category, mediascanner::Album const& album) const
 {
     CategorisedResult res(category);
-    res.set_uri("album:///" + scope.client->url_escape(album.getArtist()) + "/" + scope.client->url_escape(album.getTitle()));
+    res.set_uri(make_album_uri(album));
     res.set_title(album.getTitle());
     res.set_art(album.getArtUri());
     res["artist"] = album.getArtist();
     res["album"] = album.getTitle();
     res["isalbum"] = true;
+    if (embedded_albums < scope.embedded_albums)
+    {
+        embed_album_tracks(res, album);
+    }
     return res;
 }
 
+void MusicQuery::embed_album_tracks(CategorisedResult& result, mediascanner::Album const& album) const
+{
+    TraceSpan span("MusicQuery::embed_album_tracks");
+    Variant tracks;
+    if (!scope.album_tracks->get(album.getArtist(), album.getTitle(), generation, tracks))
+    {
+        std::vector<MediaFile> album_songs;
+        {
+            STORE_CALL("music", "MediaStore::getAlbumSongs");
+            album_songs = store().getAlbumSongs(album);
+        }
+        if (album_songs.empty())
+        {
+            return;
+        }
+        tracks = make_album_tracks(album_songs);
+        scope.album_tracks->insert(album.getArtist(), album.getTitle(), generation, tracks);
+    }
+    // albums too long to embed don't use up the allowance
+    if (tracks.get_array().size() <= MAX_EMBEDDED_TRACKS)
+    {
+        result["tracks"] = tracks;
+        embedded_albums++;
+    }
+}
+
+VariantArray MusicQuery::make_playlist(std::vector<mediascanner::MediaFile> const& songs)
+{
+    VariantArray playlist;
+    playlist.reserve(songs.size());
+    for (auto const& song: songs)
+    {
+        playlist.emplace_back(song.getUri());
+    }
+    return playlist;
+}
+
+VariantArray MusicQuery::playlist_window(VariantArray const& playlist, std::size_t position)
+{
+    if (playlist.size() <= PLAYLIST_WINDOW)
+    {
+        return playlist;
+    }
+    // a full window even for the songs at either end
+    std::size_t first = position > PLAYLIST_WINDOW_BEFORE ? position - PLAYLIST_WINDOW_BEFORE : 0;
+    first = std::min(first, playlist.size() - PLAYLIST_WINDOW);
+    return VariantArray(playlist.begin() + first, playlist.begin() + first + PLAYLIST_WINDOW);
+}
+
 unity::scopes::CategorisedResult MusicQuery::create_song_result(unity::scopes::Category::SCPtr const& category, mediascanner::MediaFile const& media,
-        bool audio_data, std::vector<mediascanner::MediaFile> const& album_songs) const
+        bool audio_data, Variant playlist) const
 {
-    std::string uri = media.getUri();
+    const std::string uri = media.getUri();
     CategorisedResult res(category);
     res.set_uri(uri);
     res.set_dnd_uri(uri);
@@ -567,16 +1165,11 @@ unity::scopes::CategorisedResult MusicQuery::create_song_result(unity::scopes::C
         VariantMap data;
         data["uri"] = uri;
         data["duration"] = media.getDuration();
-        if (album_songs.size() > 0)
+        if (!playlist.is_null())
         {
-            VariantArray songsva;
-            for (auto const& song: album_songs)
-            {
-                songsva.push_back(Variant(song.getUri()));
-            }
-            data["playlist"] = songsva;
+            data["playlist"] = std::move(playlist);
         }
-        res["audio-data"] = data;
+        res["audio-data"] = Variant(data);
     }
 
     return res;
@@ -584,15 +1177,21 @@ unity::scopes::CategorisedResult MusicQuery::create_song_result(unity::scopes::C
 
 void MusicQuery::query_albums_by_genre(unity::scopes::SearchReplyProxy const&reply, const std::string& genre) const
 {
+    TraceSpan span("MusicQuery::query_albums_by_genre");
     CategoryRenderer renderer = make_renderer(ALBUMS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
     auto cat = reply->register_category("albums", "", SONGS_CATEGORY_ICON, renderer);
 
     mediascanner::Filter filter;
     filter.setGenre(genre);
     filter.setLimit(MAX_RESULTS);
-    for (const auto &album: scope.store->listAlbums(filter))
+    std::vector<Album> albums;
     {
-        if (!reply->push(create_album_result(cat, album)))
+        STORE_CALL("music", "MediaStore::listAlbums");
+        albums = store().listAlbums(filter);
+    }
+    for (const auto &album: albums)
+    {
+        if (!push(reply, create_album_result(cat, album)))
         {
             return;
         }
@@ -613,9 +1212,9 @@ std::string MusicQuery::fetch_biography_sync(const std::string& artist, const st
     auto uri = core::net::make_uri(
             "https://dash.ubuntu.com",
             {"musicproxy", "v1", "artist-bio"},
-            {{"artist", artist}, {"album", album}, {"key", scope.api_key}});
-    config.uri = scope.client->uri_to_string(uri);
-    auto request = scope.client->get(config);
+            {{"artist", artist}, {"album", album}, {"key", scope.get_api_key()}});
+    config.uri = scope.http_client().uri_to_string(uri);
+    auto request = scope.http_client().get(config);
     http::Request::Handler handler;
     try
     {
@@ -652,13 +1251,21 @@ std::string MusicQuery::fetch_biography_sync(const std::string& artist, const st
     return bio_text;
 }
 
-void MusicQuery::query_albums_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist) const
+bool MusicQuery::uses_network() const
 {
-    CategoryRenderer bio_renderer = make_renderer(ARTIST_BIO_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
-    CategoryRenderer renderer = make_renderer(ALBUMS_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
+#ifdef ENABLE_ARTIST_BIO
+    // the biography of the artist
+    return query().has_user_data() && query().user_data().get_string() == "albums_of_artist" &&
+        search_metadata().internet_connectivity() != QueryMetadata::ConnectivityStatus::Disconnected;
+#else
+    return false;
+#endif
+}
 
-    auto biocat = reply->register_category("bio", "", "", bio_renderer);
-    auto albumcat = reply->register_category("albums", _("Albums"), SONGS_CATEGORY_ICON, renderer);
+void MusicQuery::query_albums_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist,
+        Category::SCPtr const& biocat, Category::SCPtr const& albumcat) const
+{
+    TraceSpan span("MusicQuery::query_albums_by_artist");
 
     bool show_bio = true;
     std::string bio_text;
@@ -666,7 +1273,11 @@ void MusicQuery::query_albums_by_artist(unity::scopes::SearchReplyProxy const &r
     mediascanner::Filter filter;
     filter.setArtist(artist);
     filter.setLimit(MAX_RESULTS);
-    auto const albums = scope.store->listAlbums(filter);
+    std::vector<Album> albums;
+    {
+        STORE_CALL("music", "MediaStore::listAlbums");
+        albums = store().listAlbums(filter);
+    }
 
     for (const auto &album: albums)
     {
@@ -690,30 +1301,41 @@ void MusicQuery::query_albums_by_artist(unity::scopes::SearchReplyProxy const &r
             artist_info.set_title(artist);
             artist_info["summary"] = bio_text;
             artist_info["art"] = scope.make_artist_art_uri(artist, album.getTitle());
-            reply->push(artist_info);
+            push(reply, artist_info);
             show_bio = false;
         }
-        if (!reply->push(create_album_result(albumcat, album)))
+        if (!push(reply, create_album_result(albumcat, album)))
         {
             return;
         }
     }
 }
 
-void MusicQuery::query_albums(unity::scopes::SearchReplyProxy const&reply, Category::SCPtr const& override_category) const {
+Category::SCPtr MusicQuery::albums_category(unity::scopes::SearchReplyProxy const& reply) const
+{
     const bool show_title = !query().query_string().empty();
+    CategoryRenderer renderer = make_renderer(query().query_string() == "" ? ALBUMS_CATEGORY_DEFINITION : SEARCH_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
+    return reply->register_category("albums", show_title ? _("Albums") : "", SONGS_CATEGORY_ICON, renderer);
+}
 
-    auto cat = override_category;
-    if (!cat)
-    {
-        CategoryRenderer renderer = make_renderer(query().query_string() == "" ? ALBUMS_CATEGORY_DEFINITION : SEARCH_CATEGORY_DEFINITION, MISSING_ALBUM_ART);
-        cat = reply->register_category("albums", show_title ? _("Albums") : "", SONGS_CATEGORY_ICON, renderer);
-    }
+void MusicQuery::query_albums(unity::scopes::SearchReplyProxy const&reply, Category::SCPtr const& override_category) const {
+    TraceSpan span("MusicQuery::query_albums");
+    auto const cat = override_category ? override_category : albums_category(reply);
 
     mediascanner::Filter filter;
     filter.setLimit(MAX_RESULTS);
-    for (const auto &album : scope.store->queryAlbums(query().query_string(), filter)) {
-        if (!reply->push(create_album_result(cat, album)))
+    std::vector<Album> albums;
+    if (matches && matches->grouped)
+    {
+        albums = matches->albums;
+    }
+    else
+    {
+        STORE_CALL("music", "MediaStore::queryAlbums");
+        albums = store().queryAlbums(search_string, filter);
+    }
+    for (const auto &album : albums) {
+        if (!push(reply, create_album_result(cat, album)))
         {
             return;
         }
@@ -722,14 +1344,18 @@ void MusicQuery::query_albums(unity::scopes::SearchReplyProxy const&reply, Categ
 
 MusicPreview::MusicPreview(MusicScope &scope, Result const& result, ActionMetadata const& hints)
     : PreviewQueryBase(result, hints),
-      scope(scope) {
+      scope(scope),
+      stores(scope.stores),
+      preview_cancelled(false) {
 }
 
 void MusicPreview::cancelled() {
+    preview_cancelled = true;
 }
 
 void MusicPreview::run(PreviewReplyProxy const& reply)
 {
+    TraceSpan span("MusicPreview::run");
     if(result().contains("isalbum"))
     {
         album_preview(reply);
@@ -761,7 +1387,7 @@ void MusicPreview::song_preview(unity::scopes::PreviewReplyProxy const &reply) c
     PreviewWidget artwork("art", "image");
     artwork.add_attribute_mapping("source", "art");
     artwork.add_attribute_value("fallback", Variant(
-            scope.scope_directory() + "/" + MISSING_ALBUM_ART));
+            scope.directory + "/" + MISSING_ALBUM_ART));
 
     PreviewWidget tracks("tracks", "audio");
     {
@@ -808,7 +1434,7 @@ void MusicPreview::album_preview(unity::scopes::PreviewReplyProxy const &reply)
     PreviewWidget artwork("art", "image");
     artwork.add_attribute_mapping("source", "art");
     artwork.add_attribute_value("fallback", Variant(
-            scope.scope_directory() + "/" + MISSING_ALBUM_ART));
+            scope.directory + "/" + MISSING_ALBUM_ART));
 
     PreviewWidget header("header", "header");
     header.add_attribute_mapping("title", "title");
@@ -825,26 +1451,45 @@ void MusicPreview::album_preview(unity::scopes::PreviewReplyProxy const &reply)
         actions.add_attribute_value("actions", builder.end());
     }
 
+    // the widgets above don't need the database, so they go out before the track list is there
+    if (!reply->push({artwork, header, actions}) || preview_cancelled)
+    {
+        return;
+    }
+
     PreviewWidget tracks("tracks", "audio");
-    VariantBuilder builder;
     std::string artist = res["artist"].get_string();
     std::string album_name = res["title"].get_string();
-    Album album(album_name, artist);
-    for(const auto &track : scope.store->getAlbumSongs(album)) {
-        std::vector<std::pair<std::string, Variant>> tmp;
-        tmp.emplace_back("title", Variant(track.getTitle()));
-        tmp.emplace_back("source", Variant(track.getUri()));
-        tmp.emplace_back("length", Variant(track.getDuration()));
-        builder.add_tuple(tmp);
+    Variant album_tracks;
+    if (res.contains("tracks"))
+    {
+        // the search embedded the track list in the result
+        album_tracks = res["tracks"];
     }
-    tracks.add_attribute_value("tracks", builder.end());
-    reply->push({artwork, header, actions, tracks});
-}
-
-extern "C" ScopeBase * UNITY_SCOPE_CREATE_FUNCTION() {
-    return new MusicScope;
-}
-
-extern "C" void UNITY_SCOPE_DESTROY_FUNCTION(ScopeBase *scope) {
-    delete scope;
+    else
+    {
+        const std::uint64_t generation = media_db_generation();
+        if (!scope.album_tracks->get(artist, album_name, generation, album_tracks))
+        {
+            Album album(album_name, artist);
+            std::vector<MediaFile> album_songs;
+            {
+                auto const store = stores->checkout();
+                STORE_CALL("music", "MediaStore::getAlbumSongs");
+                album_songs = store->getAlbumSongs(album);
+            }
+            if (preview_cancelled)
+            {
+                return;
+            }
+            album_tracks = make_album_tracks(album_songs);
+            scope.album_tracks->insert(artist, album_name, generation, album_tracks);
+        }
+    }
+    if (preview_cancelled)
+    {
+        return;
+    }
+    tracks.add_attribute_value("tracks", album_tracks);
+    reply->push({tracks});
 }
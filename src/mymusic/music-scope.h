@@ -3,6 +3,12 @@
 
 #include <memory>
 #include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <mediascanner/MediaStore.hh>
 #include <unity/scopes/SearchReply.h>
@@ -10,6 +16,14 @@
 #include <unity/scopes/Variant.h>
 #include <core/net/http/client.h>
 
+#include "../utils/albumtrackscache.h"
+#include "../utils/artistartcache.h"
+#include "../utils/mediacatalogue.h"
+#include "../utils/resultcache.h"
+#include "../utils/storepool.h"
+#include "../utils/typeaheadcache.h"
+#include "../utils/workerpool.h"
+
 class MusicScope : public unity::scopes::ScopeBase
 {
     friend class MusicQuery;
@@ -23,13 +37,42 @@ public:
     virtual unity::scopes::PreviewQueryBase::UPtr preview(unity::scopes::Result const& result,
                                          unity::scopes::ActionMetadata const& hints) override;
 
+    // Sets the scope up for running queries inside an aggregator process,
+    // rather than being started by the scope runtime.
+    void start_in_process(std::string const& scope_dir);
+
 private:
-    void set_api_key();
+    void open();
+    // the HTTP client and the API key are set up on first use, as few queries need them
+    core::net::http::Client& http_client() const;
+    std::string const& get_api_key() const;
     std::string make_artist_art_uri(const std::string &artist, const std::string &album) const;
 
-    std::unique_ptr<mediascanner::MediaStore> store;
-    std::shared_ptr<core::net::http::Client> client;
-    std::string api_key;
+    std::string directory;
+    // shared with the connection handles of queries still running
+    std::shared_ptr<StorePool> stores;
+    mutable std::mutex lazy_mutex;
+    mutable std::shared_ptr<core::net::http::Client> client;
+    mutable bool api_key_loaded = false;
+    mutable std::string api_key;
+    // like stores, shared with the queries still running, which stop() doesn't wait for
+    std::shared_ptr<MediaCatalogueCache> catalogue;
+    // taken on the first search short enough to be answered from it
+    std::shared_ptr<MediaKeyColumnCache> key_column;
+    // null when searches aren't refined from earlier ones
+    std::unique_ptr<TypeAheadCache> type_ahead;
+    // null when the result cache is disabled
+    std::unique_ptr<ResultCache> results;
+    std::unique_ptr<AlbumTracksCache> album_tracks;
+    std::unique_ptr<ArtistArtCache> artist_art;
+    // album results per query that carry their track list
+    std::size_t embedded_albums = 0;
+    bool unified_search = true;
+    // searches that find nothing are retried with the closest name in the catalogue,
+    // rather than only with one matching regardless of case and diacritics
+    bool fuzzy_search = false;
+    // null when the store queries of a query run one after another
+    std::shared_ptr<WorkerPool> workers;
 };
 
 class MusicQuery : public unity::scopes::SearchQueryBase
@@ -39,25 +82,90 @@ public:
     virtual void cancelled() override;
     virtual void run(unity::scopes::SearchReplyProxy const&reply) override;
 
+    // Runs the query with categories registered on reply, but hands the results
+    // to sink instead of pushing them to reply.
+    void run_in_process(unity::scopes::SearchReplyProxy const&reply,
+            std::function<bool(unity::scopes::CategorisedResult const&)> const& sink);
+
 private:
+    // the songs of a search, and the artists and albums of those songs when they are all of them
+    struct Matches
+    {
+        bool grouped = false;
+        // each with the first album among its songs, for its art
+        std::vector<std::pair<std::string, std::string>> artists;
+        std::vector<mediascanner::Album> albums;
+        TypeAheadCache::Candidates songs;
+    };
+
     const MusicScope &scope;
+    // what stop() lets go of, kept until the query is done with it
+    const std::shared_ptr<StorePool> stores;
+    const std::shared_ptr<WorkerPool> workers;
+    const std::shared_ptr<MediaCatalogueCache> catalogue;
+    const std::shared_ptr<MediaKeyColumnCache> key_column;
     std::atomic<bool> query_cancelled;
+    std::function<bool(unity::scopes::CategorisedResult const&)> sink;
+    // the query's own store connection, checked out when it starts searching
+    StorePool::Handle connection;
+    // what the store gets searched for, the query string unless it got corrected
+    std::string search_string;
+    // media_db_generation() when the query started, for what it looks up in and adds to the caches
+    std::uint64_t generation = 0;
+    // null unless the songs of the search come from a single scan
+    std::unique_ptr<Matches> matches;
+    // results pushed to the reply so far
+    mutable std::size_t pushed_results = 0;
+    // what the query registered and pushed so far, null once a result got rejected
+    mutable std::shared_ptr<ResultCache::Entry> recording;
+    // album results mostly come grouped by artist, so the last escaped artist is kept;
+    // of the sub-queries run side by side, only one makes album results
+    mutable bool escaped_artist_valid = false;
+    mutable std::string escaped_artist_key;
+    mutable std::string escaped_artist;
+    // album results of this query that got their track list so far
+    mutable std::size_t embedded_albums = 0;
 
+    mediascanner::MediaStore const& store() const;
+    bool push(unity::scopes::SearchReplyProxy const& reply, unity::scopes::CategorisedResult const& result) const;
+    void run_search(unity::scopes::SearchReplyProxy const&reply);
+    void run_concurrently(unity::scopes::SearchReplyProxy const& reply, std::vector<std::function<void()>> const& subqueries) const;
     unity::scopes::CategoryRenderer make_renderer(std::string json_text, std::string const& fallback) const;
+    // replaces the search string with the closest name in the library, if there is one
+    bool correct_search_string();
+    // runs search again with the corrected search string if it pushed nothing
+    void search_with_correction(std::function<void()> const& search);
     void populate_departments(unity::scopes::SearchReplyProxy const &reply) const;
+    void find_matches();
+    TypeAheadCache::Candidates search_songs(mediascanner::Filter const& filter) const;
     void query_songs(unity::scopes::SearchReplyProxy const&reply, unity::scopes::Category::SCPtr const& override_category = unity::scopes::Category::SCPtr(),
             bool sortByMtime = false) const;
     void query_albums(unity::scopes::SearchReplyProxy const&reply, unity::scopes::Category::SCPtr const& override_category = unity::scopes::Category::SCPtr()) const;
     void query_genres(unity::scopes::SearchReplyProxy const&reply) const;
     void query_albums_by_genre(unity::scopes::SearchReplyProxy const &reply, const std::string& genre) const;
-    void query_albums_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist) const;
-    void query_songs_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist) const;
+    void query_albums_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist,
+            unity::scopes::Category::SCPtr const& biocat, unity::scopes::Category::SCPtr const& albumcat) const;
+    void query_songs_by_artist(unity::scopes::SearchReplyProxy const &reply, const std::string& artist, unity::scopes::Category::SCPtr const& cat) const;
     void query_artists(unity::scopes::SearchReplyProxy const& reply, unity::scopes::Category::SCPtr const& override_category = unity::scopes::Category::SCPtr()) const;
+    unity::scopes::Category::SCPtr artists_category(unity::scopes::SearchReplyProxy const& reply) const;
+    unity::scopes::Category::SCPtr albums_category(unity::scopes::SearchReplyProxy const& reply) const;
+    unity::scopes::Category::SCPtr songs_category(unity::scopes::SearchReplyProxy const& reply) const;
     std::string fetch_biography_sync(const std::string& artist, const std::string &album) const;
+    // the first album of the artist with a title, for the artist art
+    std::string first_album_of(std::string const& artist) const;
+    // whether the reply carries what came from the network, so that the result cache can't keep it
+    bool uses_network() const;
 
+    std::string make_album_uri(mediascanner::Album const& album) const;
     unity::scopes::CategorisedResult create_album_result(unity::scopes::Category::SCPtr const& category, mediascanner::Album const& album) const;
+    void embed_album_tracks(unity::scopes::CategorisedResult& result, mediascanner::Album const& album) const;
+    // the URIs of the songs of a query, in order
+    static unity::scopes::VariantArray make_playlist(std::vector<mediascanner::MediaFile> const& songs);
+    // the part of playlist that the inline player of the song at position plays
+    static unity::scopes::VariantArray playlist_window(unity::scopes::VariantArray const& playlist, std::size_t position);
+    // the playlist, if not null, is moved into the audio data
     unity::scopes::CategorisedResult create_song_result(unity::scopes::Category::SCPtr const& category, mediascanner::MediaFile const& media, bool audio_data =
-            false, std::vector<mediascanner::MediaFile> const& album_songs = std::vector<mediascanner::MediaFile>()) const;
+            false, unity::scopes::Variant playlist = unity::scopes::Variant()) const;
 };
 
 class MusicPreview : public unity::scopes::PreviewQueryBase
@@ -71,6 +179,9 @@ private:
     void song_preview(unity::scopes::PreviewReplyProxy const &reply) const;
     void album_preview(unity::scopes::PreviewReplyProxy const &reply) const;
     const MusicScope &scope;
+    // kept until the preview is done with it, like the stores of a query
+    const std::shared_ptr<StorePool> stores;
+    std::atomic<bool> preview_cancelled;
 };
 
 #endif
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "video-scope.h"
+
+using namespace unity::scopes;
+
+extern "C" ScopeBase * UNITY_SCOPE_CREATE_FUNCTION() {
+    return new VideoScope;
+}
+
+extern "C" void UNITY_SCOPE_DESTROY_FUNCTION(ScopeBase *scope) {
+    delete scope;
+}
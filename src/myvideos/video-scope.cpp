@@ -33,8 +33,16 @@
 
 #include "video-scope.h"
 #include "../utils/i18n.h"
+#include "../utils/mediadb.h"
+#include "../utils/metrics.h"
+#include "../utils/searchkey.h"
+#include "../utils/storecall.h"
+#include "../utils/tracing.h"
+#include "../utils/utils.h"
 
 #define MAX_RESULTS 100
+// search strings up to this long are still being typed; they are answered from the key column
+#define MAX_TYPE_AHEAD_LENGTH 2
 
 using namespace mediascanner;
 using namespace unity::scopes;
@@ -143,11 +151,35 @@ enum class VideoType {
 
 void VideoScope::start(std::string const&) {
     init_gettext(*this);
-    store.reset(new MediaStore(MS_READ_ONLY));
+    directory = scope_directory();
+    open();
+    metrics::start_export();
+}
+
+void VideoScope::start_in_process(std::string const& scope_dir) {
+    directory = scope_dir;
+    open();
+}
+
+void VideoScope::open() {
+    // the video scope runs no sub-queries on workers
+    stores = std::make_shared<StorePool>("video", store_connections(0));
+    // taken once a search needs correcting
+    catalogue.reset(new MediaCatalogueCache(VideoMedia));
+    key_column.reset(new MediaKeyColumnCache(VideoMedia));
+    fuzzy_search = fuzzy_search_enabled();
+    type_ahead.reset(type_ahead_enabled() ? new TypeAheadCache("video") : nullptr);
+    results.reset(result_cache_enabled() ? new ResultCache("video") : nullptr);
 }
 
 void VideoScope::stop() {
-    store.reset();
+    // the queries still running hold on to these, the last one to finish lets go
+    // of them, waiting for snapshots still being taken
+    catalogue.reset();
+    key_column.reset();
+    stores.reset();
+    metrics::stop_export();
+    flush_trace();
 }
 
 SearchQueryBase::UPtr VideoScope::search(CannedQuery const &q,
@@ -164,10 +196,17 @@ PreviewQueryBase::UPtr VideoScope::preview(Result const& result,
 
 VideoQuery::VideoQuery(VideoScope &scope, CannedQuery const& query, SearchMetadata const& hints)
     : SearchQueryBase(query, hints),
-      scope(scope) {
+      scope(scope),
+      stores(scope.stores),
+      catalogue(scope.catalogue),
+      key_column(scope.key_column),
+      query_cancelled(false) {
 }
 
 void VideoQuery::cancelled() {
+    static Counter& cancellations = metrics::counter("mediascanner_queries_cancelled_total", "scope=\"video\"");
+    cancellations.inc();
+    query_cancelled = true;
 }
 
 static bool from_camera(const std::string &filename) {
@@ -175,7 +214,88 @@ static bool from_camera(const std::string &filename) {
     return boost::regex_match(filename, pattern);
 }
 
+void VideoQuery::run_in_process(SearchReplyProxy const&reply, std::function<bool(CategorisedResult const&)> const& sink) {
+    this->sink = sink;
+    run(reply);
+}
+
+bool VideoQuery::push(SearchReplyProxy const& reply, CategorisedResult const& result) const {
+    TraceSpan span("VideoQuery::push");
+    static Counter& pushed = metrics::counter("mediascanner_results_pushed_total", "scope=\"video\"");
+    static Counter& rejected = metrics::counter("mediascanner_push_rejected_total", "scope=\"video\"");
+    const bool accepted = sink ? sink(result) : reply->push(result);
+    (accepted ? pushed : rejected).inc();
+    if (!accepted) {
+        // the results after this one are missing, so the query can't be replayed
+        recording.reset();
+    } else if (recording) {
+        recording->results.push_back(result);
+    }
+    return accepted;
+}
+
+// coarse kinds of query, for the query counters
+static const char* const QUERY_CLASSES[] = {"aggregated", "camera", "downloads", "surfacing", "search"};
+
+// index of the query's kind in QUERY_CLASSES
+static std::size_t query_class(CannedQuery const& query, bool is_aggregated) {
+    if (is_aggregated) {
+        return 0;
+    }
+    if (query.department_id() == QUERY_CLASSES[1]) {
+        return 1;
+    }
+    if (query.department_id() == QUERY_CLASSES[2]) {
+        return 2;
+    }
+    return query.query_string().empty() ? 3 : 4;
+}
+
+// the query counters are looked up once, not on every query
+static Counter& queries_total(std::size_t query_class) {
+    static const std::vector<Counter*> counters = [] {
+        std::vector<Counter*> counters;
+        for (auto const name: QUERY_CLASSES) {
+            counters.push_back(&metrics::counter("mediascanner_queries_total",
+                    std::string("scope=\"video\",department=\"") + name + "\""));
+        }
+        return counters;
+    }();
+    return *counters[query_class];
+}
+
 void VideoQuery::run(SearchReplyProxy const&reply) {
+    TraceSpan span("VideoQuery::run");
+    static Histogram& latency = metrics::histogram("mediascanner_query_seconds", "scope=\"video\"");
+    ScopedLatency query_latency(latency);
+    queries_total(query_class(query(), search_metadata().is_aggregated())).inc();
+
+    if (!scope.results) {
+        run_search(reply);
+        return;
+    }
+    auto const key = ResultCache::make_key(query(), search_metadata());
+    const std::uint64_t generation = media_db_generation();
+    if (auto const cached = scope.results->get(key, generation)) {
+        ResultCache::replay(*cached, reply, [this, &reply](CategorisedResult const& result) {
+            return push(reply, result);
+        });
+        return;
+    }
+
+    recording = std::make_shared<ResultCache::Entry>();
+    recording->generation = generation;
+    run_search(reply);
+    // a cancelled query may have stopped short of its results
+    if (recording && !query_cancelled) {
+        scope.results->insert(key, recording);
+    }
+    recording.reset();
+}
+
+void VideoQuery::run_search(SearchReplyProxy const&reply) {
+    // replayed queries don't get this far, so they don't take a connection
+    connection = stores->checkout();
     const bool surfacing = query().query_string() == "";
     const bool is_aggregated = search_metadata().is_aggregated();
 
@@ -190,16 +310,16 @@ void VideoQuery::run(SearchReplyProxy const&reply) {
             res.set_uri(query().to_uri());
             res.set_title(_("Get started!"));
             res["summary"] = _("Drag and drop items from another devices. Alternatively, load your files onto a SD card.");
-            res.set_art(scope.scope_directory() + "/" + "getstarted.svg");
-            reply->push(res);
+            res.set_art(scope.directory + "/" + "getstarted.svg");
+            push(reply, res);
         } else if (surfacing) {
             const CategoryRenderer renderer(GET_STARTED_AGG_CATEGORY_DEFINITION);
             auto cat = reply->register_category("myvideos-getstarted", "", "", renderer);
             CategorisedResult res(cat);
             res.set_uri("appid://com.ubuntu.camera/camera/current-user-version");
-            res.set_art(scope.scope_directory() + "/camera-app.png");
+            res.set_art(scope.directory + "/camera-app.png");
             res.set_title(_("Nothing here yet...\nMake a video!"));
-            reply->push(res);
+            push(reply, res);
         }
         return;
     }
@@ -211,6 +331,9 @@ void VideoQuery::run(SearchReplyProxy const&reply) {
                 Department::create("downloads", query(), _("Downloaded")),
                 });
 
+        if (recording) {
+            recording->departments = root_dept;
+        }
         reply->register_departments(root_dept);
     }
 
@@ -234,7 +357,35 @@ void VideoQuery::run(SearchReplyProxy const&reply) {
     }
     mediascanner::Filter filter;
     filter.setLimit(MAX_RESULTS);
-    for (const auto &media : scope.store->query(query().query_string(), VideoMedia, filter)) {
+    std::vector<MediaFile> listed;
+    TypeAheadCache::Candidates found;
+    if (surfacing) {
+        STORE_CALL("video", "MediaStore::query");
+        listed = connection->query(query().query_string(), VideoMedia, filter);
+    } else {
+        found = search_videos(filter);
+        // search again for the closest title, so that "amelie" finds "Amélie";
+        // shorter searches were matched regardless of case and diacritics by the key column
+        if (found->empty() && search_key(query().query_string()).size() > MAX_TYPE_AHEAD_LENGTH) {
+            // the closest title has to be among the titles in the database now
+            auto const snapshot = catalogue->wait();
+            std::string correction;
+            if (snapshot) {
+                // without fuzzy search, only case and diacritics get corrected
+                correction = scope.fuzzy_search ? snapshot->closest_match(*connection, query().query_string())
+                                                : snapshot->name_containing(*connection, query().query_string());
+            }
+            if (!correction.empty() && correction != query().query_string()) {
+                static Counter& corrected = metrics::counter("mediascanner_queries_corrected_total", "scope=\"video\"");
+                corrected.inc();
+                STORE_CALL("video", "MediaStore::query");
+                listed = connection->query(correction, VideoMedia, filter);
+                found.reset();
+            }
+        }
+    }
+    auto const& videos = found ? *found : listed;
+    for (const auto &media : videos) {
         // Filter results if we are in a department
         switch (department) {
         case VideoType::ALL:
@@ -263,18 +414,48 @@ void VideoQuery::run(SearchReplyProxy const&reply) {
         // res["width"] = media.getWidth();
         // res["height"] = media.getHeight();
 
-        if(!reply->push(res))
+        if(!push(reply, res))
         {
             return;
         }
     }
 }
 
+TypeAheadCache::Candidates VideoQuery::search_videos(mediascanner::Filter const& filter) const
+{
+    const std::string key = search_key(query().query_string());
+    // until the key column of the database as it is now has been taken, short searches go to the store too
+    auto const column = key.size() <= MAX_TYPE_AHEAD_LENGTH ? key_column->get() : MediaKeyColumn::SCPtr();
+    if (column) {
+        TraceSpan scan_span("MediaKeyColumn::media_containing");
+        return std::make_shared<const std::vector<MediaFile>>(column->media_containing(query().query_string(), MAX_RESULTS));
+    }
+
+    const std::uint64_t generation = media_db_generation();
+    if (scope.type_ahead) {
+        if (auto cached = scope.type_ahead->refine(query().query_string(), generation)) {
+            return cached;
+        }
+    }
+    std::vector<MediaFile> videos;
+    {
+        STORE_CALL("video", "MediaStore::query");
+        videos = connection->query(query().query_string(), VideoMedia, filter);
+    }
+    if (!scope.type_ahead) {
+        return std::make_shared<const std::vector<MediaFile>>(std::move(videos));
+    }
+    // a list cut off at the limit may be missing videos that a longer search would find
+    const bool complete = videos.size() < MAX_RESULTS;
+    return scope.type_ahead->insert(query().query_string(), generation, std::move(videos), complete);
+}
+
 bool VideoQuery::is_database_empty() const
 {
     mediascanner::Filter filter;
     filter.setLimit(1);
-    return scope.store->query("", VideoMedia, filter).size() == 0;
+    STORE_CALL("video", "MediaStore::query");
+    return connection->query("", VideoMedia, filter).size() == 0;
 }
 
 CategoryRenderer VideoQuery::make_renderer(std::string json_text, std::string const& fallback) const
@@ -283,7 +464,7 @@ CategoryRenderer VideoQuery::make_renderer(std::string json_text, std::string co
     size_t pos = json_text.find(placeholder);
     if (pos != std::string::npos)
     {
-        json_text.replace(pos, placeholder.size(), scope.scope_directory() + "/" + fallback);
+        json_text.replace(pos, placeholder.size(), scope.directory + "/" + fallback);
     }
     return CategoryRenderer(json_text);
 }
@@ -299,6 +480,7 @@ void VideoPreview::cancelled() {
 
 void VideoPreview::run(PreviewReplyProxy const& reply)
 {
+    TraceSpan span("VideoPreview::run");
     ColumnLayout layout1col(1), layout2col(2), layout3col(3);
     layout1col.add_column({"video", "header", "actions"});
 
@@ -340,11 +522,3 @@ void VideoPreview::run(PreviewReplyProxy const& reply)
 
     reply->push({video, header, actions});
 }
-
-extern "C" ScopeBase * UNITY_SCOPE_CREATE_FUNCTION() {
-    return new VideoScope;
-}
-
-extern "C" void UNITY_SCOPE_DESTROY_FUNCTION(ScopeBase *scope) {
-    delete scope;
-}
@@ -1,13 +1,20 @@
 #ifndef VIDEO_SCOPE_H
 #define VIDEO_SCOPE_H
 
+#include <atomic>
 #include <memory>
+#include <functional>
 
 #include <mediascanner/MediaStore.hh>
 #include <unity/scopes/SearchReply.h>
 #include <unity/scopes/ScopeBase.h>
 #include <unity/scopes/Variant.h>
 
+#include "../utils/mediacatalogue.h"
+#include "../utils/resultcache.h"
+#include "../utils/storepool.h"
+#include "../utils/typeaheadcache.h"
+
 class VideoScope : public unity::scopes::ScopeBase
 {
     friend class VideoQuery;
@@ -18,8 +25,27 @@ public:
                                          unity::scopes::SearchMetadata const& hints) override;
     virtual unity::scopes::PreviewQueryBase::UPtr preview(unity::scopes::Result const& result, unity::scopes::ActionMetadata const& hints) override;
 
+    // Sets the scope up for running queries inside an aggregator process,
+    // rather than being started by the scope runtime.
+    void start_in_process(std::string const& scope_dir);
+
 private:
-    std::unique_ptr<mediascanner::MediaStore> store;
+    void open();
+
+    std::string directory;
+    // shared with the connection handles of queries still running
+    std::shared_ptr<StorePool> stores;
+    // like stores, shared with the queries still running, which stop() doesn't wait for
+    std::shared_ptr<MediaCatalogueCache> catalogue;
+    // taken on the first search short enough to be answered from it
+    std::shared_ptr<MediaKeyColumnCache> key_column;
+    // searches that find nothing are retried with the closest title in the catalogue,
+    // rather than only with one matching regardless of case and diacritics
+    bool fuzzy_search = false;
+    // null when searches aren't refined from earlier ones
+    std::unique_ptr<TypeAheadCache> type_ahead;
+    // null when the result cache is disabled
+    std::unique_ptr<ResultCache> results;
 };
 
 class VideoQuery : public unity::scopes::SearchQueryBase
@@ -30,9 +56,27 @@ public:
     virtual void run(unity::scopes::SearchReplyProxy const&reply) override;
     bool is_database_empty() const;
 
+    // Runs the query with categories registered on reply, but hands the results
+    // to sink instead of pushing them to reply.
+    void run_in_process(unity::scopes::SearchReplyProxy const&reply,
+            std::function<bool(unity::scopes::CategorisedResult const&)> const& sink);
+
 private:
     unity::scopes::CategoryRenderer make_renderer(std::string json_text, std::string const& fallback) const;
+    bool push(unity::scopes::SearchReplyProxy const& reply, unity::scopes::CategorisedResult const& result) const;
+    void run_search(unity::scopes::SearchReplyProxy const&reply);
+    TypeAheadCache::Candidates search_videos(mediascanner::Filter const& filter) const;
     const VideoScope &scope;
+    // what stop() lets go of, kept until the query is done with it
+    const std::shared_ptr<StorePool> stores;
+    const std::shared_ptr<MediaCatalogueCache> catalogue;
+    const std::shared_ptr<MediaKeyColumnCache> key_column;
+    std::atomic<bool> query_cancelled;
+    std::function<bool(unity::scopes::CategorisedResult const&)> sink;
+    // the query's own store connection, checked out when it starts searching
+    StorePool::Handle connection;
+    // what the query registered and pushed so far, null once a result got rejected
+    mutable std::shared_ptr<ResultCache::Entry> recording;
 };
 
 class VideoPreview : public unity::scopes::PreviewQueryBase
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "albumtrackscache.h"
+#include "metrics.h"
+
+using namespace unity::scopes;
+
+namespace
+{
+
+// rough size of a variant and what it holds, for the memory budget
+std::size_t footprint(Variant const& value)
+{
+    std::size_t bytes = sizeof(Variant);
+    switch (value.which())
+    {
+    case Variant::String:
+        bytes += value.get_string().size();
+        break;
+    case Variant::Array:
+        for (auto const& item: value.get_array())
+        {
+            bytes += footprint(item);
+        }
+        break;
+    case Variant::Dict:
+        for (auto const& item: value.get_dict())
+        {
+            // a map node holds the key next to the value
+            bytes += sizeof(std::string) + item.first.size() + 4 * sizeof(void*) + footprint(item.second);
+        }
+        break;
+    default:
+        break;
+    }
+    return bytes;
+}
+
+}
+
+AlbumTracksCache::AlbumTracksCache(std::size_t max_bytes)
+    : hits_(metrics::counter("mediascanner_album_tracks_cache_total", "result=\"hit\"")),
+      misses_(metrics::counter("mediascanner_album_tracks_cache_total", "result=\"miss\"")),
+      entries_(max_bytes)
+{
+}
+
+bool AlbumTracksCache::get(std::string const& artist, std::string const& album, std::uint64_t generation,
+                           Variant& tracks)
+{
+    const auto key = std::make_pair(artist, album);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto const entry = entries_.get(key);
+    if (entry == nullptr || entry->generation != generation)
+    {
+        if (entry != nullptr)
+        {
+            entries_.erase(key);
+        }
+        misses_.inc();
+        return false;
+    }
+    hits_.inc();
+    tracks = entry->tracks;
+    return true;
+}
+
+void AlbumTracksCache::insert(std::string const& artist, std::string const& album, std::uint64_t generation,
+                              Variant const& tracks)
+{
+    const std::size_t bytes = artist.size() + album.size() + footprint(tracks);
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.put(std::make_pair(artist, album), Entry{generation, tracks}, bytes);
+}
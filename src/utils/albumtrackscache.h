@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_ALBUMTRACKSCACHE_H
+#define MEDIASCANNER_SCOPE_ALBUMTRACKSCACHE_H
+
+#include "lrucache.h"
+
+#include <unity/scopes/Variant.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+
+class Counter;
+
+/*
+   The track lists of recently previewed albums, as the "tracks" attribute
+   of the preview's audio widget. People go back and forth between the same
+   few albums, and the list only changes with the media database. Bounded
+   by an estimate of the memory the lists take up.
+*/
+class AlbumTracksCache
+{
+public:
+    explicit AlbumTracksCache(std::size_t max_bytes = 1024 * 1024);
+
+    // false unless the album's tracks were cached at this media_db_generation()
+    bool get(std::string const& artist, std::string const& album, std::uint64_t generation,
+             unity::scopes::Variant& tracks);
+    void insert(std::string const& artist, std::string const& album, std::uint64_t generation,
+                unity::scopes::Variant const& tracks);
+
+private:
+    struct Entry
+    {
+        std::uint64_t generation;
+        unity::scopes::Variant tracks;
+    };
+
+    Counter& hits_;
+    Counter& misses_;
+    std::mutex mutex_;
+    LruCache<std::pair<std::string, std::string>, Entry> entries_;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "artistartcache.h"
+#include "metrics.h"
+#include "urlescape.h"
+
+#include <functional>
+
+namespace
+{
+
+const std::size_t SHARDS = 8;
+
+}
+
+ArtistArtCache::ArtistArtCache(std::size_t max_entries)
+    : hits_(metrics::counter("mediascanner_artist_art_cache_total", "result=\"hit\"")),
+      misses_(metrics::counter("mediascanner_artist_art_cache_total", "result=\"miss\""))
+{
+    for (std::size_t i = 0; i < SHARDS; i++)
+    {
+        shards_.emplace_back(new Shard(max_entries / SHARDS + 1));
+    }
+}
+
+std::string ArtistArtCache::get(std::string const& artist, std::string const& album)
+{
+    const auto key = std::make_pair(artist, album);
+    auto& shard = *shards_[std::hash<std::string>()(artist) % shards_.size()];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (auto const uri = shard.uris.get(key))
+        {
+            hits_.inc();
+            return *uri;
+        }
+    }
+    misses_.inc();
+    std::string uri = make_uri(artist, album);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.uris.put(key, uri);
+    return uri;
+}
+
+std::string ArtistArtCache::make_uri(std::string const& artist, std::string const& album)
+{
+    // what core::net::http::Client::uri_to_string() makes of
+    // make_uri("image://artistart", {}, {{"artist", artist}, {"album", album}})
+    static const std::string prefix = "image://artistart?artist=";
+    static const std::string separator = "&album=";
+    std::string uri;
+    uri.reserve(prefix.size() + separator.size() + artist.size() + album.size());
+    uri.append(prefix);
+    append_url_escaped(uri, artist);
+    uri.append(separator);
+    append_url_escaped(uri, album);
+    return uri;
+}
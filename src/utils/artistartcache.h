@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_ARTISTARTCACHE_H
+#define MEDIASCANNER_SCOPE_ARTISTARTCACHE_H
+
+#include "lrucache.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Counter;
+
+/*
+   The image://artistart URIs of recently shown artists. The artist search,
+   the albums of an artist and its bio card all ask for the same few, and a
+   URI only depends on the artist and album names. Split into shards with a
+   lock each, so that queries running at the same time rarely wait on each
+   other.
+*/
+class ArtistArtCache
+{
+public:
+    explicit ArtistArtCache(std::size_t max_entries = 2048);
+
+    ArtistArtCache(ArtistArtCache const&) = delete;
+    ArtistArtCache& operator=(ArtistArtCache const&) = delete;
+
+    // the URI of the artist's art, going by one of their albums
+    std::string get(std::string const& artist, std::string const& album);
+
+    static std::string make_uri(std::string const& artist, std::string const& album);
+
+private:
+    struct Shard
+    {
+        explicit Shard(std::size_t max_entries)
+            : uris(max_entries)
+        {
+        }
+
+        std::mutex mutex;
+        LruCache<std::pair<std::string, std::string>, std::string> uris;
+    };
+
+    Counter& hits_;
+    Counter& misses_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif
@@ -18,19 +18,193 @@
  */
 
 #include "bufferedresultforwarder.h"
+#include "tracing.h"
+
+#include <unity/scopes/SearchReply.h>
+
+#include <utility>
+
+// the runtime reports children that didn't answer in time as errors
+static const char* completion_status(unity::scopes::CompletionDetails const& details)
+{
+    switch (details.status())
+    {
+        case unity::scopes::CompletionDetails::OK:
+            return "ok";
+        case unity::scopes::CompletionDetails::Cancelled:
+            return "cancelled";
+        default:
+            return details.message().find("timeout") != std::string::npos
+                || details.message().find("timed out") != std::string::npos ? "timeout" : "error";
+    }
+}
 
 BufferedResultForwarder::BufferedResultForwarder(unity::scopes::SearchReplyProxy const& upstream,
         unity::scopes::utility::BufferedResultForwarder::SPtr const& next_forwarder,
-        std::function<bool(unity::scopes::CategorisedResult&)> const &result_filter)
+        ResultFilter result_filter)
     : unity::scopes::utility::BufferedResultForwarder(upstream, next_forwarder),
-      result_filter_(result_filter)
+      result_filter_(std::move(result_filter)),
+      next_(std::dynamic_pointer_cast<BufferedResultForwarder>(next_forwarder)),
+      early_limit_(0),
+      early_sent_(0),
+      predecessor_open_(true),
+      open_(false),
+      finished_(false),
+      buffered_(0),
+      child_latency_(nullptr),
+      child_filtered_(nullptr)
+{
+    if (next_)
+    {
+        std::lock_guard<std::mutex> lock(next_->mutex_);
+        next_->predecessor_open_ = false;
+    }
+}
+
+void BufferedResultForwarder::set_early_results(std::size_t max_results)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    early_limit_ = max_results;
+}
+
+void BufferedResultForwarder::set_first_result_timer(FirstResultTimer::SPtr const& timer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timer_ = timer;
+}
+
+void BufferedResultForwarder::set_child_metrics(std::string const& aggregator, std::string const& child)
 {
+    std::lock_guard<std::mutex> lock(mutex_);
+    child_labels_ = "aggregator=\"" + aggregator + "\",child=\"" + child + "\"";
+    child_start_ = std::chrono::steady_clock::now();
+    child_latency_ = &metrics::histogram("mediascanner_aggregator_child_seconds", child_labels_);
+    child_filtered_ = &metrics::counter("mediascanner_aggregator_child_filtered_total", child_labels_);
 }
 
 void BufferedResultForwarder::push(unity::scopes::CategorisedResult result)
 {
-    if (result_filter_(result))
+    TraceSpan span("BufferedResultForwarder::push");
+    // results are moved all the way through, the filter works on them in place
+    if (result_filter_ && !result_filter_(result))
+    {
+        if (child_filtered_)
+        {
+            child_filtered_->inc();
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!is_ready())
+    {
+        if (early_sent_ + early_.size() < early_limit_)
+        {
+            if (predecessor_open_)
+            {
+                upstream()->push(result);
+                early_sent_++;
+                result_forwarded();
+                open();
+            }
+            else
+            {
+                early_.push_back(std::move(result));
+            }
+            return;
+        }
+        // the base class buffers results until this forwarder is ready
+        buffered_++;
+        unity::scopes::utility::BufferedResultForwarder::push(std::move(result));
+        return;
+    }
+
+    result_forwarded();
+    unity::scopes::utility::BufferedResultForwarder::push(std::move(result));
+    // the forwarders after this one may show their early results once this one has shown something
+    open();
+}
+
+void BufferedResultForwarder::finished(unity::scopes::CompletionDetails const& details)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        if (child_latency_)
+        {
+            child_latency_->observe(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - child_start_));
+            metrics::counter("mediascanner_aggregator_child_finished_total",
+                    child_labels_ + ",status=\"" + completion_status(details) + "\"").inc();
+        }
+        // nothing more to show, let the forwarders after this one go ahead
+        open();
+    }
+    unity::scopes::utility::BufferedResultForwarder::finished(details);
+
+    // the forwarders after this one may have just got ready and handed on their buffered results
+    if (next_ && is_ready())
+    {
+        next_->released();
+    }
+}
+
+// must be called with mutex_ held
+void BufferedResultForwarder::open()
+{
+    if (early_limit_ == 0 || open_ || !predecessor_open_)
+    {
+        return;
+    }
+    open_ = true;
+    if (next_)
+    {
+        next_->predecessor_opened();
+    }
+}
+
+void BufferedResultForwarder::predecessor_opened()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    predecessor_open_ = true;
+    if (!early_.empty())
+    {
+        for (auto& result: early_)
+        {
+            upstream()->push(std::move(result));
+        }
+        early_sent_ += early_.size();
+        early_.clear();
+        result_forwarded();
+    }
+    if (early_sent_ > 0 || finished_)
+    {
+        open();
+    }
+}
+
+void BufferedResultForwarder::released()
+{
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffered_ > 0)
+        {
+            result_forwarded();
+            open();
+        }
+        finished = finished_;
+    }
+    if (finished && next_)
+    {
+        next_->released();
+    }
+}
+
+// must be called with mutex_ held
+void BufferedResultForwarder::result_forwarded()
+{
+    if (timer_)
     {
-        unity::scopes::utility::BufferedResultForwarder::push(result);
+        timer_->result_forwarded();
     }
 }
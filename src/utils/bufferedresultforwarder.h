@@ -23,6 +23,15 @@
 #include <unity/scopes/CategorisedResult.h>
 #include <unity/scopes/utility/BufferedResultForwarder.h>
 
+#include "firstresulttimer.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 /*
    ResultForwarder that buffers results up until it gets
    notified via on_forwarder_ready() by another ResultForwarder.
@@ -30,15 +39,54 @@
 class BufferedResultForwarder : public unity::scopes::utility::BufferedResultForwarder
 {
 public:
+    typedef std::shared_ptr<BufferedResultForwarder> SPtr;
+
+    // Decides whether a result gets forwarded; it may update the result in place.
+    typedef std::function<bool(unity::scopes::CategorisedResult&)> ResultFilter;
 
     BufferedResultForwarder(unity::scopes::SearchReplyProxy const& upstream,
             unity::scopes::utility::BufferedResultForwarder::SPtr const& next_forwarder,
-            std::function<bool(unity::scopes::CategorisedResult&)> const &result_filter = [](unity::scopes::CategorisedResult&) -> bool { return true; });
+            ResultFilter result_filter = ResultFilter());
+
+    /*
+       Show the first max_results results right away rather than holding them back until
+       all forwarders before this one have finished. They still wait for the forwarders
+       before this one to show something (or finish), so categories keep their order.
+    */
+    void set_early_results(std::size_t max_results);
+
+    // Gets told when results of this forwarder go upstream.
+    void set_first_result_timer(FirstResultTimer::SPtr const& timer);
+
+    // Count filtered results and time the child scope from now until it finishes.
+    void set_child_metrics(std::string const& aggregator, std::string const& child);
 
     virtual void push(unity::scopes::CategorisedResult result) override;
+    virtual void finished(unity::scopes::CompletionDetails const& details) override;
 
 private:
-    const std::function<bool(unity::scopes::CategorisedResult&)> result_filter_;
+    void open();
+    void predecessor_opened();
+    void released();
+    void result_forwarded();
+
+    const ResultFilter result_filter_;
+    SPtr next_;
+
+    std::mutex mutex_;
+    std::size_t early_limit_;
+    std::size_t early_sent_;
+    std::vector<unity::scopes::CategorisedResult> early_;
+    bool predecessor_open_;
+    bool open_;
+    bool finished_;
+    std::size_t buffered_;
+    FirstResultTimer::SPtr timer_;
+
+    std::string child_labels_;
+    std::chrono::steady_clock::time_point child_start_;
+    Histogram *child_latency_;
+    Counter *child_filtered_;
 };
 
 #endif
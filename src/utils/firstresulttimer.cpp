@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "firstresulttimer.h"
+#include "metrics.h"
+
+FirstResultTimer::FirstResultTimer(std::string const& aggregator, std::string const& mode)
+    : searches_(metrics::counter("mediascanner_aggregator_searches_total",
+                "aggregator=\"" + aggregator + "\",mode=\"" + mode + "\"")),
+      first_result_(metrics::histogram("mediascanner_aggregator_first_result_seconds",
+                "aggregator=\"" + aggregator + "\",mode=\"" + mode + "\"")),
+      start_(std::chrono::steady_clock::now()),
+      seen_(false),
+      elapsed_us_(0)
+{
+}
+
+FirstResultTimer::~FirstResultTimer()
+{
+    searches_.inc();
+    if (seen_)
+    {
+        first_result_.observe(std::chrono::microseconds(elapsed_us_.load()));
+    }
+}
+
+void FirstResultTimer::result_forwarded()
+{
+    if (!seen_.exchange(true))
+    {
+        elapsed_us_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+    }
+}
+
+void FirstResultTimer::log_summary(std::ostream& out, std::string const& aggregator)
+{
+    for (auto const mode: {"ordered", "interleaved"})
+    {
+        const std::string labels = "aggregator=\"" + aggregator + "\",mode=\"" + mode + "\"";
+        auto const searches = metrics::counter("mediascanner_aggregator_searches_total", labels).value();
+        auto const& first_result = metrics::histogram("mediascanner_aggregator_first_result_seconds", labels);
+        if (searches == 0)
+        {
+            continue;
+        }
+        out << "Time to first result (" << mode << "): " << searches << " searches, "
+            << first_result.count() << " with results";
+        if (first_result.count() > 0)
+        {
+            out << ", mean " << first_result.sum() * 1000.0 / first_result.count() << " ms";
+        }
+        out << std::endl;
+    }
+}
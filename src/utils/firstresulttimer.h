@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FIRSTRESULTTIMER_H_
+#define FIRSTRESULTTIMER_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <string>
+
+class Counter;
+class Histogram;
+
+/*
+   Measures the time from the start of an aggregated search until its first
+   result goes upstream. The timing is added to the time-to-first-result
+   histogram of the aggregator and merge mode when the timer goes away.
+*/
+class FirstResultTimer
+{
+public:
+    typedef std::shared_ptr<FirstResultTimer> SPtr;
+
+    FirstResultTimer(std::string const& aggregator, std::string const& mode);
+    ~FirstResultTimer();
+
+    FirstResultTimer(FirstResultTimer const&) = delete;
+    FirstResultTimer& operator=(FirstResultTimer const&) = delete;
+
+    void result_forwarded();
+
+    // writes the number of searches and the mean time to first result per merge mode
+    static void log_summary(std::ostream& out, std::string const& aggregator);
+
+private:
+    Counter& searches_;
+    Histogram& first_result_;
+    const std::chrono::steady_clock::time_point start_;
+    std::atomic<bool> seen_;
+    std::atomic<long> elapsed_us_;
+};
+
+#endif
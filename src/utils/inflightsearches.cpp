@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "inflightsearches.h"
+#include "tracing.h"
+#include <unity/scopes/FilterState.h>
+#include <unity/scopes/QueryCtrl.h>
+#include <unity/scopes/ScopeMetadata.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace unity::scopes;
+
+namespace
+{
+
+// per-process table of subsearches that haven't finished yet
+class InFlightTable
+{
+public:
+    static InFlightTable& instance()
+    {
+        static InFlightTable table;
+        return table;
+    }
+
+    // returns the search joined by 'joiner', or a new one for 'owner' to start, setting 'created'
+    InFlightSearch::SPtr join(InFlightSearch::Key const& key, SearchListenerBase::SPtr const& joiner,
+            SearchListenerBase::SPtr const& owner, bool& created)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = searches_.find(key);
+        if (it != searches_.end() && it->second->join(joiner))
+        {
+            created = false;
+            return it->second;
+        }
+        auto search = std::make_shared<InFlightSearch>(key);
+        search->join(owner);
+        searches_[key] = search;
+        created = true;
+        return search;
+    }
+
+    void erase(InFlightSearch::Key const& key, InFlightSearch const* search)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = searches_.find(key);
+        if (it != searches_.end() && it->second.get() == search)
+        {
+            searches_.erase(it);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<InFlightSearch::Key, InFlightSearch::SPtr> searches_;
+};
+
+}
+
+InFlightSearch::InFlightSearch(Key const& key)
+    : key_(key),
+      done_(false),
+      details_(CompletionDetails::OK)
+{
+}
+
+void InFlightSearch::push(CategorisedResult result)
+{
+    std::vector<std::shared_ptr<Listener>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_)
+        {
+            return;
+        }
+        results_.push_back(std::move(result));
+        listeners = listeners_;
+    }
+    for (auto const& listener: listeners)
+    {
+        deliver(listener);
+    }
+}
+
+void InFlightSearch::finished(CompletionDetails const& details)
+{
+    // nobody can join once the search is over
+    close();
+
+    std::vector<std::shared_ptr<Listener>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_)
+        {
+            return;
+        }
+        done_ = true;
+        details_ = details;
+        listeners = listeners_;
+        ctrl_.reset();
+    }
+    for (auto const& listener: listeners)
+    {
+        deliver(listener);
+    }
+}
+
+void InFlightSearch::deliver(std::shared_ptr<Listener> const& listener)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (listener->busy)
+    {
+        // the thread handing it results picks the new ones up as well
+        return;
+    }
+    listener->busy = true;
+    while (!listener->left && listener->next < results_.size())
+    {
+        CategorisedResult result = results_[listener->next++];
+        lock.unlock();
+        listener->listener->push(std::move(result));
+        lock.lock();
+    }
+    const bool finish = done_ && !listener->left && !listener->finished;
+    listener->finished = listener->finished || finish;
+    listener->busy = false;
+    if (finish)
+    {
+        const CompletionDetails details = details_;
+        lock.unlock();
+        listener->listener->finished(details);
+    }
+}
+
+bool InFlightSearch::join(SearchListenerBase::SPtr const& listener)
+{
+    auto const joined = std::make_shared<Listener>();
+    joined->listener = listener;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done_)
+    {
+        return false;
+    }
+    listeners_.push_back(joined);
+    return true;
+}
+
+void InFlightSearch::replay(SearchListenerBase::SPtr const& listener)
+{
+    std::shared_ptr<Listener> joined;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(listeners_.begin(), listeners_.end(), [&listener](std::shared_ptr<Listener> const& l) {
+                return l->listener == listener;
+            });
+        if (it == listeners_.end())
+        {
+            return;
+        }
+        joined = *it;
+    }
+    deliver(joined);
+}
+
+void InFlightSearch::leave(SearchListenerBase::SPtr const& listener)
+{
+    QueryCtrlProxy ctrl;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(listeners_.begin(), listeners_.end(), [&listener](std::shared_ptr<Listener> const& l) {
+                return l->listener == listener;
+            });
+        if (it == listeners_.end())
+        {
+            return;
+        }
+        (*it)->left = true;
+        listeners_.erase(it);
+        if (done_ || !listeners_.empty())
+        {
+            return;
+        }
+        done_ = true;
+        ctrl.swap(ctrl_);
+    }
+
+    close();
+    if (ctrl)
+    {
+        ctrl->cancel();
+    }
+}
+
+void InFlightSearch::close()
+{
+    InFlightTable::instance().erase(key_, this);
+}
+
+void InFlightSearch::set_query_ctrl(QueryCtrlProxy const& ctrl)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!done_)
+        {
+            ctrl_ = ctrl;
+            return;
+        }
+    }
+    // everybody left before the child query got started
+    if (ctrl)
+    {
+        ctrl->cancel();
+    }
+}
+
+namespace
+{
+
+/*
+   Hands the results of a joined subsearch to the query's reply. If the
+   subsearch gets cancelled because the query that started it was, it starts
+   a child query for this query and skips the results the reply already got.
+*/
+class JoinedListener : public SearchListenerBase, public std::enable_shared_from_this<JoinedListener>
+{
+public:
+    JoinedListener(std::shared_ptr<CoalescedSearches::State> const& state,
+            SearchListenerBase::SPtr const& reply, CoalescedSearches::Launcher const& launch)
+        : state_(state),
+          reply_(reply),
+          launch_(launch)
+    {
+    }
+
+    void push(CategorisedResult result) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (skip_ > 0)
+            {
+                skip_--;
+                return;
+            }
+            delivered_++;
+        }
+        reply_->push(std::move(result));
+    }
+
+    void finished(CompletionDetails const& details) override
+    {
+        if (details.status() == CompletionDetails::Cancelled && restart())
+        {
+            return;
+        }
+        reply_->finished(details);
+    }
+
+private:
+    bool restart()
+    {
+        {
+            std::lock_guard<std::mutex> state_lock(state_->mutex);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_->cancelled || restarted_)
+            {
+                return false;
+            }
+            restarted_ = true;
+            skip_ = delivered_;
+        }
+        // the runtime cancels it along with this query
+        try
+        {
+            launch_(shared_from_this());
+        }
+        catch (std::exception const& e)
+        {
+            reply_->finished(CompletionDetails(CompletionDetails::Error, e.what()));
+        }
+        return true;
+    }
+
+    std::shared_ptr<CoalescedSearches::State> const state_;
+    SearchListenerBase::SPtr const reply_;
+    CoalescedSearches::Launcher const launch_;
+    std::mutex mutex_;
+    bool restarted_ = false;
+    std::size_t delivered_ = 0;
+    std::size_t skip_ = 0;
+};
+
+}
+
+CoalescedSearches::CoalescedSearches()
+    : state_(std::make_shared<State>())
+{
+}
+
+CoalescedSearches::~CoalescedSearches()
+{
+    cancel();
+}
+
+void CoalescedSearches::subsearch(ChildScope const& child,
+        std::string const& query_string,
+        std::string const& department_id,
+        SearchMetadata const& metadata,
+        SearchListenerBase::SPtr const& reply,
+        Launcher const& launch)
+{
+    TraceSpan span("CoalescedSearches::subsearch");
+    const InFlightSearch::Key key(child.id, query_string, department_id, metadata.cardinality(), metadata.locale());
+    bool created = false;
+    InFlightSearch::SPtr search;
+    SearchListenerBase::SPtr listener;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->cancelled)
+        {
+            return;
+        }
+        // a query that joins gets its results through a listener that can take over
+        auto const joined = std::make_shared<JoinedListener>(state_, reply, launch);
+        search = InFlightTable::instance().join(key, joined, reply, created);
+        listener = created ? reply : SearchListenerBase::SPtr(joined);
+        state_->searches.emplace_back(search, listener, created);
+    }
+
+    if (!created)
+    {
+        search->replay(listener);
+        return;
+    }
+    try
+    {
+        search->set_query_ctrl(launch(search));
+    }
+    catch (std::exception const& e)
+    {
+        search->finished(CompletionDetails(CompletionDetails::Error, e.what()));
+        throw;
+    }
+}
+
+void CoalescedSearches::cancel()
+{
+    std::vector<std::tuple<InFlightSearch::SPtr, SearchListenerBase::SPtr, bool>> searches;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->cancelled = true;
+        searches.swap(state_->searches);
+    }
+    for (auto const& search: searches)
+    {
+        // queries that come later don't join a child query the runtime is about to cancel
+        if (std::get<2>(search))
+        {
+            std::get<0>(search)->close();
+        }
+        std::get<0>(search)->leave(std::get<1>(search));
+    }
+}
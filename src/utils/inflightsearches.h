@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INFLIGHTSEARCHES_H_
+#define INFLIGHTSEARCHES_H_
+
+#include <unity/scopes/ChildScope.h>
+#include <unity/scopes/CompletionDetails.h>
+#include <unity/scopes/QueryCtrlProxyFwd.h>
+#include <unity/scopes/SearchListenerBase.h>
+#include <unity/scopes/SearchMetadata.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*
+   A subsearch of a child scope shared by all aggregator queries
+   that ask that child the same question while it is still running.
+   Results received so far are replayed to late joiners, so every
+   listener sees the complete result set.
+*/
+class InFlightSearch : public unity::scopes::SearchListenerBase
+{
+public:
+    typedef std::shared_ptr<InFlightSearch> SPtr;
+
+    // (child id, query string, department id, cardinality, locale)
+    typedef std::tuple<std::string, std::string, std::string, int, std::string> Key;
+
+    explicit InFlightSearch(Key const& key);
+
+    virtual void push(unity::scopes::CategorisedResult result) override;
+    virtual void finished(unity::scopes::CompletionDetails const& details) override;
+
+    // returns false if the search is already over and cannot be joined anymore;
+    // the listener gets nothing until replay() is called for it
+    bool join(unity::scopes::SearchListenerBase::SPtr const& listener);
+    // hands a joined listener the results received so far, outside of any lock
+    void replay(unity::scopes::SearchListenerBase::SPtr const& listener);
+    // the child query gets cancelled when the last listener leaves
+    void leave(unity::scopes::SearchListenerBase::SPtr const& listener);
+    // no query joins it from now on
+    void close();
+
+    void set_query_ctrl(unity::scopes::QueryCtrlProxy const& ctrl);
+
+private:
+    struct Listener
+    {
+        unity::scopes::SearchListenerBase::SPtr listener;
+        // index of the next result it gets
+        std::size_t next = 0;
+        // a thread is handing it results
+        bool busy = false;
+        bool left = false;
+        bool finished = false;
+    };
+
+    // hands listener the results it hasn't got yet, and the completion once there is one;
+    // called outside of the lock by every thread that has something new for it
+    void deliver(std::shared_ptr<Listener> const& listener);
+
+    const Key key_;
+    std::mutex mutex_;
+    bool done_;
+    unity::scopes::CompletionDetails details_;
+    unity::scopes::QueryCtrlProxy ctrl_;
+    std::vector<std::shared_ptr<Listener>> listeners_;
+    std::vector<unity::scopes::CategorisedResult> results_;
+};
+
+/*
+   Subsearches of a single aggregator query. Identical subsearches issued by
+   concurrent queries of this process are coalesced into one child query.
+   The child query is started through the first query's subsearch(), so that
+   the runtime ties it to that query; the queries that joined it start one of
+   their own if it gets cancelled with the first query.
+*/
+class CoalescedSearches
+{
+public:
+    // starts the child query for this aggregator query, through SearchQueryBase::subsearch()
+    typedef std::function<unity::scopes::QueryCtrlProxy(unity::scopes::SearchListenerBase::SPtr const& listener)> Launcher;
+
+    CoalescedSearches();
+    // leaves the joined subsearches, so that none starts a child query for a query that is gone
+    ~CoalescedSearches();
+
+    CoalescedSearches(CoalescedSearches const&) = delete;
+    CoalescedSearches& operator=(CoalescedSearches const&) = delete;
+
+    void subsearch(unity::scopes::ChildScope const& child,
+            std::string const& query_string,
+            std::string const& department_id,
+            unity::scopes::SearchMetadata const& metadata,
+            unity::scopes::SearchListenerBase::SPtr const& reply,
+            Launcher const& launch);
+
+    // leave all joined subsearches, called when the query gets cancelled
+    void cancel();
+
+    // shared with the listeners of joined subsearches
+    struct State
+    {
+        std::mutex mutex;
+        bool cancelled = false;
+        // (search, listener, whether this query started it)
+        std::vector<std::tuple<InFlightSearch::SPtr, unity::scopes::SearchListenerBase::SPtr, bool>> searches;
+    };
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_LRUCACHE_H
+#define MEDIASCANNER_SCOPE_LRUCACHE_H
+
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <map>
+#include <tuple>
+#include <utility>
+
+/*
+   Values by key, least recently used first out once the cost of all values
+   goes over max_cost. The cost of a value is whatever the owner chooses:
+   1 for a cache bounded by number of entries, bytes for one bounded by size.
+   Not thread safe, owners lock around it.
+*/
+template<typename Key, typename Value>
+class LruCache
+{
+public:
+    explicit LruCache(std::size_t max_cost)
+        : max_cost_(max_cost),
+          cost_(0)
+    {
+    }
+
+    LruCache(LruCache const&) = delete;
+    LruCache& operator=(LruCache const&) = delete;
+
+    // null if key isn't cached, otherwise key becomes the most recently used
+    Value const* get(Key const& key)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &std::get<1>(*it->second);
+    }
+
+    // replaces any value of key; a value costing more than max_cost is not kept at all
+    void put(Key const& key, Value value, std::size_t cost = 1)
+    {
+        erase(key);
+        if (cost > max_cost_)
+        {
+            return;
+        }
+        entries_.emplace_front(key, std::move(value), cost);
+        index_[key] = entries_.begin();
+        cost_ += cost;
+        while (cost_ > max_cost_)
+        {
+            auto last = std::prev(entries_.end());
+            cost_ -= std::get<2>(*last);
+            index_.erase(std::get<0>(*last));
+            entries_.erase(last);
+        }
+    }
+
+    void erase(Key const& key)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            return;
+        }
+        cost_ -= std::get<2>(*it->second);
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+        cost_ = 0;
+    }
+
+    std::size_t size() const
+    {
+        return entries_.size();
+    }
+
+    std::size_t cost() const
+    {
+        return cost_;
+    }
+
+private:
+    // (key, value, cost), most recently used first
+    typedef std::list<std::tuple<Key, Value, std::size_t>> Entries;
+
+    const std::size_t max_cost_;
+    std::size_t cost_;
+    Entries entries_;
+    std::map<Key, typename Entries::iterator> index_;
+};
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mediacatalogue.h"
+#include "mediadb.h"
+#include "searchkey.h"
+#include "substringscan.h"
+#include "tracing.h"
+
+#include <mediascanner/Filter.hh>
+#include <mediascanner/MediaFile.hh>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace mediascanner;
+
+namespace
+{
+
+// shorter queries are still being typed rather than misspelled
+const std::size_t MIN_QUERY_LENGTH = 4;
+// low enough for "beatels" to find "The Beatles"
+const float MIN_SCORE = 0.35f;
+// keeps the fields of a song apart in the media column
+const char FIELD_SEPARATOR = '\x1f';
+
+// Calls found(id, entry, end, match) for the entries of column containing key, in column order,
+// until it returns false. Entries are NUL terminated and offsets holds where each of them starts;
+// keys have no NULs, so no match can span two entries. match is the first one in the entry,
+// which runs from entry to the NUL at end.
+template<typename Found>
+void scan_column(std::string const& column, std::vector<std::uint32_t> const& offsets,
+        std::string const& key, Found const& found)
+{
+    if (key.empty())
+    {
+        return;
+    }
+    const char *begin = column.data();
+    std::size_t pos = 0;
+    for (;;)
+    {
+        const char *match = find_substring(begin + pos, column.size() - pos, key.data(), key.size());
+        if (match == nullptr)
+        {
+            break;
+        }
+        auto const it = std::upper_bound(offsets.begin(), offsets.end(), std::uint32_t(match - begin));
+        const std::uint32_t id = (it - offsets.begin()) - 1;
+        // carry on with the next entry
+        pos = id + 1 < offsets.size() ? offsets[id + 1] : column.size();
+        if (!found(id, begin + offsets[id], begin + pos - 1, match))
+        {
+            break;
+        }
+    }
+}
+
+// how media_containing() orders its matches
+enum MatchRank
+{
+    TITLE_WORD,
+    OTHER_WORD,
+    TITLE_INSIDE,
+    OTHER_INSIDE,
+    MATCH_RANKS
+};
+
+bool starts_word(const char *entry, const char *match)
+{
+    if (match == entry)
+    {
+        return true;
+    }
+    // keys are case folded, and bytes of multibyte characters are letters too
+    const unsigned char before = match[-1];
+    return before < 0x80 && !(before >= 'a' && before <= 'z') && !(before >= '0' && before <= '9');
+}
+
+// the best rank of the occurrences of key in an entry, starting from its first one at match
+MatchRank match_rank(const char *entry, const char *end, const char *match, std::string const& key)
+{
+    MatchRank best = MATCH_RANKS;
+    for (; match != nullptr; match = find_substring(match + 1, end - match - 1, key.data(), key.size()))
+    {
+        const bool title = std::find(entry, match, FIELD_SEPARATOR) == match;
+        const MatchRank rank = starts_word(entry, match) ? (title ? TITLE_WORD : OTHER_WORD)
+                                                        : (title ? TITLE_INSIDE : OTHER_INSIDE);
+        best = std::min(best, rank);
+        if (best == TITLE_WORD)
+        {
+            break;
+        }
+    }
+    return best;
+}
+
+}
+
+MediaCatalogue::MediaCatalogue(MediaStore const& store, MediaType type)
+    : generation_(media_db_generation())
+{
+    TraceSpan span("MediaCatalogue::MediaCatalogue");
+    std::unordered_set<std::string> seen;
+    auto const add = [this, &seen](MediaFile const& media, std::string const& name, Field field) {
+        if (name.empty() || !seen.insert(name).second)
+        {
+            return;
+        }
+        if (files_.empty() || files_.back() != media.getFileName())
+        {
+            files_.push_back(media.getFileName());
+        }
+        const std::string key = search_key(name);
+        keys_offsets_.push_back(keys_.size());
+        keys_.append(key).push_back('\0');
+        sources_.push_back(Source{std::uint32_t(files_.size() - 1), field});
+        index_.add(key);
+    };
+    for (auto const& media: store.query("", type, Filter()))
+    {
+        add(media, media.getTitle(), TITLE);
+        if (type == AudioMedia)
+        {
+            add(media, media.getAuthor(), AUTHOR);
+            add(media, media.getAlbum(), ALBUM);
+        }
+    }
+    index_.build();
+    keys_.shrink_to_fit();
+    keys_offsets_.shrink_to_fit();
+    sources_.shrink_to_fit();
+    files_.shrink_to_fit();
+}
+
+std::string MediaCatalogue::name_containing(MediaStore const& store, std::string const& query) const
+{
+    const std::uint32_t none = keys_offsets_.size();
+    std::uint32_t shortest = none;
+    for (auto id: containing(query))
+    {
+        if (shortest == none || key_size(id) < key_size(shortest))
+        {
+            shortest = id;
+        }
+    }
+    return shortest == none ? std::string() : name(store, shortest);
+}
+
+std::string MediaCatalogue::closest_match(MediaStore const& store, std::string const& query) const
+{
+    if (query.size() < MIN_QUERY_LENGTH)
+    {
+        return std::string();
+    }
+    const std::string containing = name_containing(store, query);
+    if (!containing.empty())
+    {
+        return containing;
+    }
+
+    auto const matches = index_.search(search_key(query), 1, MIN_SCORE);
+    return matches.empty() ? std::string() : name(store, matches[0].id);
+}
+
+std::vector<std::uint32_t> MediaCatalogue::containing(std::string const& query) const
+{
+    std::vector<std::uint32_t> ids;
+    scan_column(keys_, keys_offsets_, search_key(query), [&ids](std::uint32_t id, const char*, const char*, const char*) {
+        ids.push_back(id);
+        return true;
+    });
+    return ids;
+}
+
+std::string MediaCatalogue::name(MediaStore const& store, std::uint32_t id) const
+{
+    Source const& source = sources_.at(id);
+    try
+    {
+        const MediaFile media = store.lookup(files_[source.file]);
+        switch (source.field)
+        {
+        case TITLE:
+            return media.getTitle();
+        case AUTHOR:
+            return media.getAuthor();
+        case ALBUM:
+            return media.getAlbum();
+        }
+    }
+    catch (std::exception const& e)
+    {
+        // removed since the snapshot was taken
+        std::cerr << "Could not look up " << files_[source.file] << ": " << e.what() << std::endl;
+    }
+    return std::string();
+}
+
+std::size_t MediaCatalogue::key_size(std::uint32_t id) const
+{
+    const std::size_t end = id + 1 < keys_offsets_.size() ? keys_offsets_[id + 1] : keys_.size();
+    // without the NUL
+    return end - keys_offsets_[id] - 1;
+}
+
+std::uint64_t MediaCatalogue::generation() const
+{
+    return generation_;
+}
+
+std::size_t MediaCatalogue::size() const
+{
+    return keys_offsets_.size();
+}
+
+MediaKeyColumn::MediaKeyColumn(MediaStore const& store, MediaType type)
+    : generation_(media_db_generation())
+{
+    TraceSpan span("MediaKeyColumn::MediaKeyColumn");
+    // name -> key, every name is only folded once
+    std::unordered_map<std::string, std::string> keys;
+    auto const key_of = [&keys](std::string const& name) -> std::string const& {
+        auto it = keys.find(name);
+        if (it == keys.end())
+        {
+            it = keys.emplace(name, search_key(name)).first;
+        }
+        return it->second;
+    };
+    media_ = store.query("", type, Filter());
+    for (auto const& media: media_)
+    {
+        offsets_.push_back(keys_.size());
+        keys_.append(key_of(media.getTitle()));
+        if (type == AudioMedia)
+        {
+            keys_.append(1, FIELD_SEPARATOR).append(key_of(media.getAuthor()));
+            keys_.append(1, FIELD_SEPARATOR).append(key_of(media.getAlbum()));
+        }
+        keys_.push_back('\0');
+    }
+    keys_.shrink_to_fit();
+    offsets_.shrink_to_fit();
+    media_.shrink_to_fit();
+}
+
+std::vector<MediaFile> MediaKeyColumn::media_containing(std::string const& query, std::size_t limit) const
+{
+    const std::string key = search_key(query);
+    std::vector<std::uint32_t> ranked[MATCH_RANKS];
+    scan_column(keys_, offsets_, key, [&](std::uint32_t id, const char *entry, const char *end, const char *match) {
+        auto& ids = ranked[match_rank(entry, end, match, key)];
+        if (ids.size() < limit)
+        {
+            ids.push_back(id);
+        }
+        // nothing ranks above a full page of titles with a word starting with the query
+        return ranked[TITLE_WORD].size() < limit;
+    });
+
+    std::vector<MediaFile> media;
+    for (auto const& ids: ranked)
+    {
+        for (auto id: ids)
+        {
+            if (media.size() == limit)
+            {
+                return media;
+            }
+            media.push_back(media_[id]);
+        }
+    }
+    return media;
+}
+
+std::uint64_t MediaKeyColumn::generation() const
+{
+    return generation_;
+}
+
+std::size_t MediaKeyColumn::size() const
+{
+    return media_.size();
+}
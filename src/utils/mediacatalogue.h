@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_MEDIACATALOGUE_H
+#define MEDIASCANNER_SCOPE_MEDIACATALOGUE_H
+
+#include "snapshotcache.h"
+#include "trigramindex.h"
+
+#include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaStore.hh>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+   Snapshot of the names in the media store, for finding what a query the
+   store's full text search found nothing for meant: the song titles, artists
+   and albums of the music, or the titles of the videos. Names are compared
+   by their search_key(), so case and diacritics don't matter.
+
+   Only the keys are kept, along with a song or video each name came from;
+   the name itself is read back from the store once it is the one looked for.
+*/
+class MediaCatalogue
+{
+public:
+    typedef std::shared_ptr<const MediaCatalogue> SCPtr;
+
+    MediaCatalogue(mediascanner::MediaStore const& store, mediascanner::MediaType type);
+
+    // The shortest name whose key contains the key of query, or an empty string,
+    // so that "motorhead" finds Motörhead.
+    std::string name_containing(mediascanner::MediaStore const& store, std::string const& query) const;
+
+    // The name closest to query, or an empty string when nothing is close enough.
+    // The shortest name containing the query wins, after that the best trigram match.
+    std::string closest_match(mediascanner::MediaStore const& store, std::string const& query) const;
+
+    // ids of the names whose key contains the key of query
+    std::vector<std::uint32_t> containing(std::string const& query) const;
+    // the name with the given id, as the store has it
+    std::string name(mediascanner::MediaStore const& store, std::uint32_t id) const;
+
+    // media_db_generation() of the database the snapshot was taken from
+    std::uint64_t generation() const;
+    std::size_t size() const;
+
+private:
+    enum Field : std::uint8_t
+    {
+        TITLE,
+        AUTHOR,
+        ALBUM
+    };
+
+    // where the name with an id came from: files_[file] has it as field
+    struct Source
+    {
+        std::uint32_t file;
+        Field field;
+    };
+
+    std::size_t key_size(std::uint32_t id) const;
+
+    std::uint64_t generation_;
+    // the keys of all names, each followed by a NUL; keys_offsets_[id] is where the key of name id starts
+    std::string keys_;
+    std::vector<std::uint32_t> keys_offsets_;
+    std::vector<Source> sources_;
+    // the songs or videos that brought in a name, each only once
+    std::vector<std::string> files_;
+    // over the keys, the ids are the same as for keys_offsets_
+    TrigramIndex index_;
+};
+
+typedef SnapshotCache<MediaCatalogue> MediaCatalogueCache;
+
+/*
+   Snapshot of the keys of every song's title, artist and album, or of every
+   video's title, in one column, for answering queries that are still being
+   typed without going to the store. Along with the column it keeps what the
+   results are made of, the songs or videos themselves.
+*/
+class MediaKeyColumn
+{
+public:
+    typedef std::shared_ptr<const MediaKeyColumn> SCPtr;
+
+    MediaKeyColumn(mediascanner::MediaStore const& store, mediascanner::MediaType type);
+
+    // Up to limit songs or videos whose title, artist or album contains the key of query.
+    // Unlike the full text search, this matches inside words, but those matches come last:
+    // titles with a word starting with the query rank first, then artists and albums with
+    // one, each in store order.
+    std::vector<mediascanner::MediaFile> media_containing(std::string const& query, std::size_t limit) const;
+
+    // media_db_generation() of the database the snapshot was taken from
+    std::uint64_t generation() const;
+    std::size_t size() const;
+
+private:
+    std::uint64_t generation_;
+    // per song or video, the keys of its title, artist and album separated by 0x1f and followed by a NUL
+    std::string keys_;
+    std::vector<std::uint32_t> offsets_;
+    std::vector<mediascanner::MediaFile> media_;
+};
+
+typedef SnapshotCache<MediaKeyColumn> MediaKeyColumnCache;
+
+#endif
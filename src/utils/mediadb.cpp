@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mediadb.h"
+
+#include <glib.h>
+#include <sys/stat.h>
+#include <cstdlib>
+
+namespace
+{
+
+void mix(std::uint64_t& hash, std::uint64_t value)
+{
+    hash = (hash ^ value) * 1099511628211ull;
+}
+
+void mix_file(std::uint64_t& hash, std::string const& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        mix(hash, 0);
+        return;
+    }
+    mix(hash, st.st_mtim.tv_sec);
+    mix(hash, st.st_mtim.tv_nsec);
+    mix(hash, st.st_size);
+    mix(hash, st.st_ino);
+}
+
+}
+
+std::string media_db_path()
+{
+    // the same place MediaStore looks for it
+    const char *cachedir = getenv("MEDIASCANNER_CACHEDIR");
+    if (cachedir != nullptr)
+    {
+        return std::string(cachedir) + "/mediastore.db";
+    }
+    return std::string(g_get_user_cache_dir()) + "/mediascanner-2.0/mediastore.db";
+}
+
+std::uint64_t media_db_generation()
+{
+    const std::string path = media_db_path();
+    std::uint64_t hash = 14695981039346656037ull;
+    mix_file(hash, path);
+    mix_file(hash, path + "-wal");
+    return hash;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_MEDIADB_H
+#define MEDIASCANNER_SCOPE_MEDIADB_H
+
+#include <cstdint>
+#include <string>
+
+// the media database opened by MediaStore, in MEDIASCANNER_CACHEDIR or the user cache directory
+std::string media_db_path();
+
+// Changes whenever the media scanner writes to the database, going by the
+// modification time and size of the database and its write-ahead log.
+std::uint64_t media_db_generation();
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "metrics.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+const std::array<double, 13> Histogram::BOUNDS {{
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+}};
+
+void Histogram::observe(std::chrono::microseconds duration)
+{
+    const double seconds = duration.count() / 1e6;
+    const std::size_t i = std::lower_bound(BOUNDS.begin(), BOUNDS.end(), seconds) - BOUNDS.begin();
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+namespace
+{
+
+struct Entry
+{
+    Entry(std::string const& name, std::string const& labels, bool is_histogram, Entry *next)
+        : name(name), labels(labels), is_histogram(is_histogram),
+          counter(is_histogram ? nullptr : new Counter),
+          histogram(is_histogram ? new Histogram : nullptr),
+          next(next)
+    {
+    }
+
+    const std::string name;
+    const std::string labels;
+    const bool is_histogram;
+    // only the kind that was registered
+    const std::unique_ptr<Counter> counter;
+    const std::unique_ptr<Histogram> histogram;
+    Entry *const next;
+};
+
+// registered metrics form a list that only ever grows, so it can be read without locking
+std::atomic<Entry*> head(nullptr);
+std::mutex register_mutex;
+
+Entry* find(Entry *entry, std::string const& name, std::string const& labels)
+{
+    for (; entry; entry = entry->next)
+    {
+        if (entry->name == name && entry->labels == labels)
+        {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+Entry& checked(Entry& entry, bool is_histogram)
+{
+    if (entry.is_histogram != is_histogram)
+    {
+        throw std::logic_error("metric " + entry.name + " is already registered as a " +
+                (entry.is_histogram ? "histogram" : "counter"));
+    }
+    return entry;
+}
+
+Entry& lookup(std::string const& name, std::string const& labels, bool is_histogram)
+{
+    if (Entry *entry = find(head.load(std::memory_order_acquire), name, labels))
+    {
+        return checked(*entry, is_histogram);
+    }
+    std::lock_guard<std::mutex> lock(register_mutex);
+    Entry *const first = head.load(std::memory_order_acquire);
+    if (Entry *entry = find(first, name, labels))
+    {
+        return checked(*entry, is_histogram);
+    }
+    // never freed, metrics live as long as the process
+    Entry *entry = new Entry(name, labels, is_histogram, first);
+    head.store(entry, std::memory_order_release);
+    return *entry;
+}
+
+std::string with_label(std::string const& labels, std::string const& extra)
+{
+    if (labels.empty())
+    {
+        return "{" + extra + "}";
+    }
+    return "{" + labels + "," + extra + "}";
+}
+
+std::string braced(std::string const& labels)
+{
+    return labels.empty() ? std::string() : "{" + labels + "}";
+}
+
+class Exporter
+{
+public:
+    static Exporter& instance()
+    {
+        static Exporter *exporter = new Exporter;
+        return *exporter;
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (users_++ > 0)
+        {
+            return;
+        }
+        const char *file = getenv("MEDIASCANNER_METRICS_FILE");
+        const char *socket_path = getenv("MEDIASCANNER_METRICS_SOCKET");
+        const char *interval = getenv("MEDIASCANNER_METRICS_INTERVAL");
+        file_ = file ? file : "";
+        socket_path_ = socket_path ? socket_path : "";
+        interval_s_ = interval && atoi(interval) > 0 ? atoi(interval) : 10;
+        if (file_.empty() && socket_path_.empty())
+        {
+            return;
+        }
+        if (pipe(wakeup_) < 0)
+        {
+            std::cerr << "Failed to start metrics export: " << strerror(errno) << std::endl;
+            return;
+        }
+        thread_ = std::thread(&Exporter::run, this);
+    }
+
+    void stop()
+    {
+        std::thread thread;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (users_ == 0 || --users_ > 0 || !thread_.joinable())
+            {
+                return;
+            }
+            thread.swap(thread_);
+            if (write(wakeup_[1], "x", 1) < 0)
+            {
+                std::cerr << "Failed to stop metrics export: " << strerror(errno) << std::endl;
+            }
+        }
+        thread.join();
+        close(wakeup_[0]);
+        close(wakeup_[1]);
+    }
+
+private:
+    void run()
+    {
+        const int listener = socket_path_.empty() ? -1 : listen_on(socket_path_);
+        while (true)
+        {
+            struct pollfd fds[2] = {{wakeup_[0], POLLIN, 0}, {listener, POLLIN, 0}};
+            const int ready = poll(fds, listener >= 0 ? 2 : 1, interval_s_ * 1000);
+            if (ready < 0 && errno != EINTR)
+            {
+                std::cerr << "Metrics export failed: " << strerror(errno) << std::endl;
+                break;
+            }
+            if (fds[0].revents)
+            {
+                break;
+            }
+            if (listener >= 0 && fds[1].revents)
+            {
+                serve(listener);
+            }
+            if (ready == 0 && !file_.empty())
+            {
+                write_file();
+            }
+        }
+        if (!file_.empty())
+        {
+            write_file();
+        }
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(socket_path_.c_str());
+        }
+    }
+
+    static int listen_on(std::string const& path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "Metrics socket path too long: " << path << std::endl;
+            return -1;
+        }
+        strcpy(addr.sun_path, path.c_str());
+        unlink(path.c_str());
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 4) < 0)
+        {
+            std::cerr << "Failed to listen on metrics socket " << path << ": " << strerror(errno) << std::endl;
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
+
+    static void serve(int listener)
+    {
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            return;
+        }
+        const std::string text = metrics::exposition();
+        std::size_t written = 0;
+        while (written < text.size())
+        {
+            const ssize_t n = send(client, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                break;
+            }
+            written += n;
+        }
+        close(client);
+    }
+
+    void write_file() const
+    {
+        // write to a temporary file first, so that readers never see a partial export
+        const std::string tmp = file_ + ".tmp";
+        FILE *out = fopen(tmp.c_str(), "w");
+        if (!out)
+        {
+            std::cerr << "Failed to write metrics to " << tmp << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        fputs(metrics::exposition().c_str(), out);
+        fclose(out);
+        if (rename(tmp.c_str(), file_.c_str()) < 0)
+        {
+            std::cerr << "Failed to write metrics to " << file_ << ": " << strerror(errno) << std::endl;
+        }
+    }
+
+    std::mutex mutex_;
+    int users_ = 0;
+    std::thread thread_;
+    int wakeup_[2] = {-1, -1};
+    std::string file_;
+    std::string socket_path_;
+    int interval_s_ = 10;
+};
+
+}
+
+namespace metrics
+{
+
+Counter& counter(std::string const& name, std::string const& labels)
+{
+    return *lookup(name, labels, false).counter;
+}
+
+Histogram& histogram(std::string const& name, std::string const& labels)
+{
+    return *lookup(name, labels, true).histogram;
+}
+
+std::string exposition()
+{
+    // group the samples of a metric under a single TYPE line
+    std::map<std::string, std::vector<Entry const*>> by_name;
+    for (Entry const* entry = head.load(std::memory_order_acquire); entry; entry = entry->next)
+    {
+        by_name[entry->name].push_back(entry);
+    }
+
+    std::ostringstream out;
+    for (auto const& metric: by_name)
+    {
+        auto const& name = metric.first;
+        const bool is_histogram = metric.second.front()->is_histogram;
+        out << "# TYPE " << name << (is_histogram ? " histogram" : " counter") << "\n";
+        for (auto it = metric.second.rbegin(); it != metric.second.rend(); ++it)
+        {
+            Entry const& entry = **it;
+            if (!is_histogram)
+            {
+                out << name << braced(entry.labels) << " " << entry.counter->value() << "\n";
+                continue;
+            }
+            uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < Histogram::BOUNDS.size(); i++)
+            {
+                cumulative += entry.histogram->bucket(i);
+                std::ostringstream bound;
+                bound << Histogram::BOUNDS[i];
+                out << name << "_bucket" << with_label(entry.labels, "le=\"" + bound.str() + "\"") << " " << cumulative << "\n";
+            }
+            cumulative += entry.histogram->bucket(Histogram::BOUNDS.size());
+            out << name << "_bucket" << with_label(entry.labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+            out << name << "_sum" << braced(entry.labels) << " " << entry.histogram->sum() << "\n";
+            out << name << "_count" << braced(entry.labels) << " " << entry.histogram->count() << "\n";
+        }
+    }
+    return out.str();
+}
+
+void start_export()
+{
+    Exporter::instance().start();
+}
+
+void stop_export()
+{
+    Exporter::instance().stop();
+}
+
+}
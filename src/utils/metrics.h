@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_METRICS_H
+#define MEDIASCANNER_SCOPE_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+   Process-wide counters and latency histograms, exported in Prometheus text format.
+
+   Metrics are looked up by name and labels (e.g. "scope=\"music\""); the returned
+   references stay valid for the lifetime of the process, so hot paths look them
+   up once and then only touch atomics. Lookups don't take a lock either, only
+   registering a new metric does.
+*/
+class Counter
+{
+public:
+    void inc(uint64_t n = 1)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Histogram
+{
+public:
+    // upper bounds of the buckets in seconds, the last bucket is +Inf
+    static const std::array<double, 13> BOUNDS;
+
+    void observe(std::chrono::microseconds duration);
+
+    uint64_t bucket(std::size_t i) const
+    {
+        return buckets_[i].load(std::memory_order_relaxed);
+    }
+    uint64_t count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+    double sum() const
+    {
+        return sum_us_.load(std::memory_order_relaxed) / 1e6;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, 14> buckets_ {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+};
+
+// observes the time from construction to destruction
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(Histogram& histogram)
+        : histogram_(histogram),
+          start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedLatency()
+    {
+        histogram_.observe(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_));
+    }
+
+    ScopedLatency(ScopedLatency const&) = delete;
+    ScopedLatency& operator=(ScopedLatency const&) = delete;
+
+private:
+    Histogram& histogram_;
+    const std::chrono::steady_clock::time_point start_;
+};
+
+namespace metrics
+{
+
+Counter& counter(std::string const& name, std::string const& labels = "");
+Histogram& histogram(std::string const& name, std::string const& labels = "");
+
+// all metrics in Prometheus text exposition format
+std::string exposition();
+
+/*
+   Exports the metrics every MEDIASCANNER_METRICS_INTERVAL seconds (10 by default)
+   to the file MEDIASCANNER_METRICS_FILE, and/or serves them to every client
+   connecting to the Unix socket MEDIASCANNER_METRICS_SOCKET. Does nothing if
+   neither is set. Calls nest, the exporter runs until the last stop_export().
+*/
+void start_export();
+void stop_export();
+
+}
+
+#endif
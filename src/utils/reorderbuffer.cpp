@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "reorderbuffer.h"
+
+using namespace unity::scopes;
+
+namespace
+{
+
+thread_local ReorderBuffer::Lane* current = nullptr;
+
+}
+
+ReorderBuffer::ReorderBuffer(std::size_t lanes, std::size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1),
+      lanes_(lanes)
+{
+}
+
+ReorderBuffer::Lane::Lane(ReorderBuffer& buffer, std::size_t index)
+    : buffer_(buffer),
+      index_(index),
+      previous_(current)
+{
+    current = this;
+}
+
+ReorderBuffer::Lane::~Lane()
+{
+    current = previous_;
+    buffer_.close(index_);
+}
+
+bool ReorderBuffer::Lane::push(CategorisedResult const& result)
+{
+    return buffer_.push(index_, result);
+}
+
+ReorderBuffer::Lane* ReorderBuffer::current_lane()
+{
+    return current;
+}
+
+bool ReorderBuffer::push(std::size_t lane, CategorisedResult const& result)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // the lanes before this one never wait for it, so drain() gets here
+        room_.wait(lock, [this, lane] { return rejected_ || lanes_[lane].results.size() < capacity_; });
+        if (rejected_)
+        {
+            return false;
+        }
+        lanes_[lane].results.push_back(result);
+    }
+    cond_.notify_one();
+    return true;
+}
+
+void ReorderBuffer::close(std::size_t lane)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lanes_[lane].closed = true;
+    }
+    cond_.notify_one();
+}
+
+bool ReorderBuffer::drain(std::function<bool(CategorisedResult const&)> const& push)
+{
+    for (auto& lane: lanes_)
+    {
+        for (;;)
+        {
+            std::deque<CategorisedResult> results;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&lane] { return lane.closed || !lane.results.empty(); });
+                if (lane.results.empty())
+                {
+                    break;
+                }
+                results.swap(lane.results);
+            }
+            room_.notify_all();
+            for (auto const& result: results)
+            {
+                if (!push(result))
+                {
+                    reject();
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void ReorderBuffer::reject()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rejected_ = true;
+    }
+    room_.notify_all();
+}
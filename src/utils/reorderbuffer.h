@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_REORDERBUFFER_H
+#define MEDIASCANNER_SCOPE_REORDERBUFFER_H
+
+#include <unity/scopes/CategorisedResult.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+   Results of sub-queries running side by side, put back in the order the
+   sub-queries would have pushed them in one after another. Each sub-query
+   pushes into a lane of its own; the results of a lane go out as soon as
+   all the lanes before it are done. A lane holds up to 'capacity' results,
+   pushing more waits for drain() to get to it.
+*/
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(std::size_t lanes, std::size_t capacity = 32);
+
+    // Points the pushes of the calling thread at a lane while it exists,
+    // and closes the lane when it goes.
+    class Lane
+    {
+    public:
+        Lane(ReorderBuffer& buffer, std::size_t index);
+        ~Lane();
+
+        Lane(Lane const&) = delete;
+        Lane& operator=(Lane const&) = delete;
+
+        // false once no more results are wanted; waits while the lane is full
+        bool push(unity::scopes::CategorisedResult const& result);
+
+    private:
+        ReorderBuffer& buffer_;
+        const std::size_t index_;
+        Lane* const previous_;
+    };
+
+    // the lane of the calling thread, or null
+    static Lane* current_lane();
+
+    // Hands the results to push lane by lane until every lane is closed. Returns
+    // false as soon as push rejects a result; the lanes take no more after that.
+    bool drain(std::function<bool(unity::scopes::CategorisedResult const&)> const& push);
+
+    // The lanes take no more results, and pushes waiting for room return false.
+    // For giving up on the sub-queries without draining them.
+    void reject();
+
+private:
+    struct LaneState
+    {
+        std::deque<unity::scopes::CategorisedResult> results;
+        bool closed = false;
+    };
+
+    bool push(std::size_t lane, unity::scopes::CategorisedResult const& result);
+    void close(std::size_t lane);
+
+    const std::size_t capacity_;
+    std::mutex mutex_;
+    // results or a closed lane for drain()
+    std::condition_variable cond_;
+    // room in the lanes for push()
+    std::condition_variable room_;
+    std::vector<LaneState> lanes_;
+    bool rejected_ = false;
+};
+
+#endif
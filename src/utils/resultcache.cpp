@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "resultcache.h"
+#include "metrics.h"
+#include "tracing.h"
+#include <unity/scopes/Category.h>
+#include <unity/scopes/SearchReply.h>
+#include <iostream>
+#include <map>
+
+using namespace unity::scopes;
+
+ResultCache::ResultCache(std::string const& scope, std::size_t capacity)
+    : hits_(metrics::counter("mediascanner_result_cache_total", "scope=\"" + scope + "\",result=\"hit\"")),
+      misses_(metrics::counter("mediascanner_result_cache_total", "scope=\"" + scope + "\",result=\"miss\"")),
+      entries_(capacity)
+{
+}
+
+ResultCache::Key ResultCache::make_key(CannedQuery const& query, SearchMetadata const& metadata)
+{
+    return Key(query.query_string(),
+               query.department_id(),
+               query.has_user_data() ? query.user_data().serialize_json() : std::string(),
+               metadata.is_aggregated(),
+               metadata.cardinality(),
+               metadata.locale(),
+               static_cast<int>(metadata.internet_connectivity()));
+}
+
+ResultCache::EntryPtr ResultCache::get(Key const& key, std::uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto const entry = entries_.get(key);
+    if (entry == nullptr)
+    {
+        misses_.inc();
+        return EntryPtr();
+    }
+    if ((*entry)->generation != generation)
+    {
+        // the database changed since, the entry won't be any good anymore
+        entries_.erase(key);
+        misses_.inc();
+        return EntryPtr();
+    }
+    hits_.inc();
+    return *entry;
+}
+
+void ResultCache::insert(Key const& key, EntryPtr const& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.put(key, entry);
+}
+
+void ResultCache::replay(Entry const& entry, SearchReplyProxy const& reply,
+                         std::function<bool(CategorisedResult const&)> const& push)
+{
+    TraceSpan span("ResultCache::replay");
+    if (entry.departments)
+    {
+        try
+        {
+            reply->register_departments(entry.departments);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to register departments: " << e.what() << std::endl;
+        }
+    }
+
+    // categories are registered on reply as their first result comes up
+    std::map<std::string, Category::SCPtr> categories;
+    for (auto const& cached: entry.results)
+    {
+        auto const& original = cached.category();
+        Category::SCPtr& category = categories[original->id()];
+        if (!category)
+        {
+            auto const query = original->query();
+            category = query
+                ? reply->register_category(original->id(), original->title(), original->icon(), *query, original->renderer_template())
+                : reply->register_category(original->id(), original->title(), original->icon(), original->renderer_template());
+        }
+        CategorisedResult result(cached);
+        result.set_category(category);
+        if (!push(result))
+        {
+            return;
+        }
+    }
+}
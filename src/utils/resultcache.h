@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_RESULTCACHE_H
+#define MEDIASCANNER_SCOPE_RESULTCACHE_H
+
+#include "lrucache.h"
+
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/Department.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/SearchReplyProxyFwd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class Counter;
+
+/*
+   The departments and results of the last few queries of a scope. The same
+   few queries, like surfacing when the Dash opens, come in over and over,
+   and give the same results until the media database changes. So a query
+   that ran to completion is kept, and a repeat of it gets replayed into its
+   reply instead of being run again. Queries whose reply carries what came
+   from the network must not be recorded, as there's no telling when that
+   changes. Setting MEDIASCANNER_RESULT_CACHE=0 turns the cache off.
+*/
+class ResultCache
+{
+public:
+    // (query string, department id, user data as JSON, aggregated, cardinality, locale,
+    // internet connectivity)
+    typedef std::tuple<std::string, std::string, std::string, bool, int, std::string, int> Key;
+
+    struct Entry
+    {
+        // the media_db_generation() the query started at
+        std::uint64_t generation = 0;
+        // null if the query didn't register any
+        unity::scopes::Department::SCPtr departments;
+        std::vector<unity::scopes::CategorisedResult> results;
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    // scope labels the hit and miss counters
+    explicit ResultCache(std::string const& scope, std::size_t capacity = 16);
+
+    static Key make_key(unity::scopes::CannedQuery const& query, unity::scopes::SearchMetadata const& metadata);
+
+    // null unless key was cached at this generation
+    EntryPtr get(Key const& key, std::uint64_t generation);
+    void insert(Key const& key, EntryPtr const& entry);
+
+    // Registers the departments and categories of entry on reply and hands the
+    // results, now in categories of reply, to push until it returns false.
+    static void replay(Entry const& entry, unity::scopes::SearchReplyProxy const& reply,
+                std::function<bool(unity::scopes::CategorisedResult const&)> const& push);
+
+private:
+    Counter& hits_;
+    Counter& misses_;
+    std::mutex mutex_;
+    LruCache<Key, EntryPtr> entries_;
+};
+
+#endif
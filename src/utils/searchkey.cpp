@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "searchkey.h"
+
+#include <glib.h>
+
+namespace
+{
+
+// letters that don't decompose into a base letter and a mark
+const char* fold_letter(gunichar c)
+{
+    switch (c)
+    {
+    case 0x00e6: return "ae"; // æ
+    case 0x00f0: return "d";  // ð
+    case 0x00f8: return "o";  // ø
+    case 0x0111: return "d";  // đ
+    case 0x0131: return "i";  // ı
+    case 0x0142: return "l";  // ł
+    case 0x0153: return "oe"; // œ
+    case 0x00fe: return "th"; // þ
+    default: return nullptr;
+    }
+}
+
+bool is_mark(gunichar c)
+{
+    const GUnicodeType type = g_unichar_type(c);
+    return type == G_UNICODE_NON_SPACING_MARK || type == G_UNICODE_SPACING_MARK || type == G_UNICODE_ENCLOSING_MARK;
+}
+
+}
+
+std::string search_key(std::string const& text)
+{
+    std::string key;
+    key.reserve(text.size());
+
+    bool ascii = true;
+    for (unsigned char c: text)
+    {
+        if (c >= 0x80)
+        {
+            ascii = false;
+            break;
+        }
+        key.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    // invalid UTF-8 is left as it is
+    if (ascii || !g_utf8_validate(text.data(), text.size(), nullptr))
+    {
+        return ascii ? key : text;
+    }
+
+    gchar *folded = g_utf8_casefold(text.data(), text.size());
+    gchar *decomposed = g_utf8_normalize(folded, -1, G_NORMALIZE_NFD);
+    g_free(folded);
+    if (decomposed == nullptr)
+    {
+        return text;
+    }
+
+    key.clear();
+    for (const gchar *p = decomposed; *p; p = g_utf8_next_char(p))
+    {
+        const gunichar c = g_utf8_get_char(p);
+        if (is_mark(c))
+        {
+            continue;
+        }
+        if (const char *letter = fold_letter(c))
+        {
+            key += letter;
+            continue;
+        }
+        gchar utf8[6];
+        key.append(utf8, g_unichar_to_utf8(c, utf8));
+    }
+    g_free(decomposed);
+    return key;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_SEARCHKEY_H
+#define MEDIASCANNER_SCOPE_SEARCHKEY_H
+
+#include <string>
+
+// Case folded text with diacritics stripped, so that "Motörhead" and "motorhead",
+// or "Sigur Rós" and "sigur ros", give the same key.
+std::string search_key(std::string const& text);
+
+#endif
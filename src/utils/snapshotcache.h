@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_SNAPSHOTCACHE_H
+#define MEDIASCANNER_SCOPE_SNAPSHOTCACHE_H
+
+#include "mediadb.h"
+
+#include <mediascanner/MediaStore.hh>
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+   A snapshot of one media type in the store, taken again once the media
+   database has changed, and only when it is asked for. Taking it reads the
+   whole library, so that happens on a thread of its own with a store
+   connection of its own, never on the query asking.
+
+   Snapshot is constructed from (MediaStore const&, MediaType), and has a
+   generation() giving the media_db_generation() it was taken at.
+*/
+template<typename Snapshot>
+class SnapshotCache
+{
+public:
+    typedef std::shared_ptr<const Snapshot> SCPtr;
+
+    explicit SnapshotCache(mediascanner::MediaType type)
+        : type_(type), taking_(false)
+    {
+    }
+
+    // waits for a snapshot still being taken
+    ~SnapshotCache()
+    {
+        if (taker_.joinable())
+        {
+            taker_.join();
+        }
+    }
+
+    SnapshotCache(SnapshotCache const&) = delete;
+    SnapshotCache& operator=(SnapshotCache const&) = delete;
+
+    // The snapshot of the database as it is now, or null while it is being taken.
+    SCPtr get()
+    {
+        const std::uint64_t generation = media_db_generation();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current(generation))
+        {
+            return current_;
+        }
+        start_taking();
+        return SCPtr();
+    }
+
+    // The same, but waiting for the snapshot to be taken. Null if that failed.
+    SCPtr wait()
+    {
+        const std::uint64_t generation = media_db_generation();
+        std::unique_lock<std::mutex> lock(mutex_);
+        // the snapshot being taken may have started before the last change, the next one can't have
+        for (int attempt = 0; attempt < 2 && !current(generation); attempt++)
+        {
+            start_taking();
+            taken_.wait(lock, [this] { return !taking_; });
+        }
+        return current_;
+    }
+
+private:
+    bool current(std::uint64_t generation) const
+    {
+        return current_ && current_->generation() == generation;
+    }
+
+    // with mutex_ held
+    void start_taking()
+    {
+        if (taking_)
+        {
+            return;
+        }
+        // the last one is done with the snapshot, all that is left is to return
+        if (taker_.joinable())
+        {
+            taker_.join();
+        }
+        taking_ = true;
+        taker_ = std::thread(&SnapshotCache::take, this);
+    }
+
+    // runs on taker_
+    void take()
+    {
+        SCPtr snapshot;
+        try
+        {
+            mediascanner::MediaStore store(mediascanner::MS_READ_ONLY);
+            snapshot = std::make_shared<const Snapshot>(store, type_);
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "Could not take a snapshot of the media store: " << e.what() << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (snapshot)
+        {
+            // the previous snapshot goes once the queries using it are done
+            current_ = snapshot;
+        }
+        taking_ = false;
+        taken_.notify_all();
+    }
+
+    const mediascanner::MediaType type_;
+    std::mutex mutex_;
+    std::condition_variable taken_;
+    SCPtr current_;
+    bool taking_;
+    std::thread taker_;
+};
+
+#endif
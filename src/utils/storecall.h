@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_STORECALL_H
+#define MEDIASCANNER_SCOPE_STORECALL_H
+
+#include "metrics.h"
+#include "tracing.h"
+
+#include <string>
+
+/*
+   Times a call into the media store for the trace and for the
+   mediascanner_store_call_seconds histogram, from construction to destruction.
+   Call sites use STORE_CALL, which looks the histogram up once per site:
+
+       STORE_CALL("music", "MediaStore::query");
+       auto songs = store.query(...);
+*/
+class StoreCall
+{
+public:
+    // call must be a string literal, such as "MediaStore::query"
+    StoreCall(const char *call, Histogram& latency)
+        : span_(call),
+          latency_(latency)
+    {
+    }
+
+    static Histogram& latency(const char *scope, const char *call)
+    {
+        return metrics::histogram("mediascanner_store_call_seconds",
+                std::string("scope=\"") + scope + "\",call=\"" + call + "\"");
+    }
+
+private:
+    TraceSpan span_;
+    ScopedLatency latency_;
+};
+
+// times the rest of the enclosing block as a call of the given scope
+#define STORE_CALL(scope, call) \
+    static Histogram& STORE_CALL_NAME_(store_call_latency_, __LINE__) = StoreCall::latency(scope, call); \
+    StoreCall STORE_CALL_NAME_(store_call_, __LINE__)(call, STORE_CALL_NAME_(store_call_latency_, __LINE__))
+#define STORE_CALL_NAME_(prefix, line) STORE_CALL_CONCAT_(prefix, line)
+#define STORE_CALL_CONCAT_(prefix, line) prefix##line
+
+#endif
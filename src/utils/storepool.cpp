@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "storepool.h"
+#include "metrics.h"
+
+#include <exception>
+#include <iostream>
+#include <utility>
+
+using namespace mediascanner;
+
+StorePool::StorePool(std::string const& scope, std::size_t size)
+    : size_(size > 0 ? size : 1),
+      opened_(metrics::counter("mediascanner_store_connections_opened_total", "scope=\"" + scope + "\""))
+{
+    warmer_ = std::thread(&StorePool::warm_up, this);
+}
+
+StorePool::~StorePool()
+{
+    warmer_.join();
+}
+
+void StorePool::warm_up()
+{
+    std::unique_ptr<MediaStore> store;
+    try
+    {
+        store.reset(new MediaStore(MS_READ_ONLY));
+    }
+    catch (std::exception const& e)
+    {
+        // the first query tries again, and fails with this error
+        std::cerr << "Could not open the media store: " << e.what() << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        warming_up_ = false;
+        if (store)
+        {
+            idle_.push_back(std::move(store));
+        }
+    }
+    cond_.notify_all();
+}
+
+StorePool::Handle StorePool::checkout()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // the first connection is almost there, so don't open another one
+        cond_.wait(lock, [this] { return !warming_up_ || !idle_.empty(); });
+        if (!idle_.empty())
+        {
+            std::unique_ptr<MediaStore> store = std::move(idle_.back());
+            idle_.pop_back();
+            return Handle(shared_from_this(), std::move(store));
+        }
+    }
+    // opening a connection takes a while, so not under the lock
+    opened_.inc();
+    return Handle(shared_from_this(), std::unique_ptr<MediaStore>(new MediaStore(MS_READ_ONLY)));
+}
+
+std::size_t StorePool::idle() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+void StorePool::checkin(std::unique_ptr<MediaStore> store)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < size_)
+        {
+            idle_.push_back(std::move(store));
+            return;
+        }
+    }
+    // one too many, closed outside of the lock
+    store.reset();
+}
+
+StorePool::Handle::Handle(std::shared_ptr<StorePool> pool, std::unique_ptr<MediaStore> store)
+    : pool_(std::move(pool)),
+      store_(std::move(store))
+{
+}
+
+StorePool::Handle& StorePool::Handle::operator=(Handle&& other)
+{
+    if (this != &other)
+    {
+        give_back();
+        pool_ = std::move(other.pool_);
+        store_ = std::move(other.store_);
+    }
+    return *this;
+}
+
+StorePool::Handle::~Handle()
+{
+    give_back();
+}
+
+void StorePool::Handle::give_back()
+{
+    if (pool_ && store_)
+    {
+        pool_->checkin(std::move(store_));
+    }
+    store_.reset();
+    // the last handle of a pool the scope dropped takes it down
+    pool_.reset();
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_STOREPOOL_H
+#define MEDIASCANNER_SCOPE_STOREPOOL_H
+
+#include <mediascanner/MediaStore.hh>
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Counter;
+
+/*
+   Read-only connections to the media store, so that queries and previews
+   running at the same time each have one of their own rather than sharing
+   a single SQLite connection. A query checks a connection out for as long
+   as it runs. Up to 'size' connections are kept open between queries; when
+   more are running at once, the extra ones get a connection that is closed
+   when they give it back, rather than waiting for one.
+
+   The pool starts out empty and opens its first connection on a thread of
+   its own, so that starting a scope doesn't wait for the database.
+
+   It has to be owned by a shared_ptr. Every handle keeps the pool alive, so a
+   scope that stops can drop the pool while queries still hold connections.
+*/
+class StorePool : public std::enable_shared_from_this<StorePool>
+{
+public:
+    // 'scope' labels the metrics
+    StorePool(std::string const& scope, std::size_t size);
+    // waits for the first connection, if it is still being opened
+    ~StorePool();
+
+    StorePool(StorePool const&) = delete;
+    StorePool& operator=(StorePool const&) = delete;
+
+    // a checked out connection, given back when the handle goes away
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(Handle&& other) = default;
+        Handle& operator=(Handle&& other);
+        ~Handle();
+
+        explicit operator bool() const
+        {
+            return bool(store_);
+        }
+        mediascanner::MediaStore const& operator*() const
+        {
+            return *store_;
+        }
+        mediascanner::MediaStore const* operator->() const
+        {
+            return store_.get();
+        }
+
+    private:
+        friend class StorePool;
+        Handle(std::shared_ptr<StorePool> pool, std::unique_ptr<mediascanner::MediaStore> store);
+        void give_back();
+
+        std::shared_ptr<StorePool> pool_;
+        std::unique_ptr<mediascanner::MediaStore> store_;
+    };
+
+    // waits for the first connection if it is being opened and none is idle
+    Handle checkout();
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+    // connections open between queries
+    std::size_t idle() const;
+
+private:
+    void warm_up();
+    void checkin(std::unique_ptr<mediascanner::MediaStore> store);
+
+    const std::size_t size_;
+    Counter& opened_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    bool warming_up_ = true;
+    std::vector<std::unique_ptr<mediascanner::MediaStore>> idle_;
+    std::thread warmer_;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "substringscan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+namespace
+{
+
+const char* find_scalar(const char *haystack, std::size_t size, const char *needle, std::size_t needle_size)
+{
+    return static_cast<const char*>(memmem(haystack, size, needle, needle_size));
+}
+
+#ifdef HAVE_X86_SIMD
+
+// bits of mask are candidate positions from block; returns the first one holding the needle
+inline const char* verify(unsigned mask, const char *block, const char *needle, std::size_t needle_size)
+{
+    while (mask != 0)
+    {
+        const int bit = __builtin_ctz(mask);
+        // first and last bytes are known to match
+        if (memcmp(block + bit + 1, needle + 1, needle_size - 2) == 0)
+        {
+            return block + bit;
+        }
+        mask &= mask - 1;
+    }
+    return nullptr;
+}
+
+__attribute__((target("sse2")))
+const char* find_sse2(const char *haystack, std::size_t size, const char *needle, std::size_t needle_size)
+{
+    if (needle_size < 2 || size < needle_size)
+    {
+        return find_scalar(haystack, size, needle, needle_size);
+    }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_size - 1]);
+    std::size_t i = 0;
+    for (; i + needle_size - 1 + 16 <= size; i += 16)
+    {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + needle_size - 1));
+        const unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                              _mm_cmpeq_epi8(last, block_last)));
+        if (const char *match = verify(mask, haystack + i, needle, needle_size))
+        {
+            return match;
+        }
+    }
+    return find_scalar(haystack + i, size - i, needle, needle_size);
+}
+
+__attribute__((target("avx2")))
+const char* find_avx2(const char *haystack, std::size_t size, const char *needle, std::size_t needle_size)
+{
+    if (needle_size < 2 || size < needle_size)
+    {
+        return find_scalar(haystack, size, needle, needle_size);
+    }
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+    std::size_t i = 0;
+    for (; i + needle_size - 1 + 32 <= size; i += 32)
+    {
+        const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + needle_size - 1));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                                                    _mm256_cmpeq_epi8(last, block_last)));
+        if (const char *match = verify(mask, haystack + i, needle, needle_size))
+        {
+            return match;
+        }
+    }
+    return find_sse2(haystack + i, size - i, needle, needle_size);
+}
+
+#endif
+
+SubstringFinder pick_finder()
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return find_avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return find_sse2;
+    }
+#endif
+    return find_scalar;
+}
+
+}
+
+const char* find_substring(const char *haystack, std::size_t size, const char *needle, std::size_t needle_size)
+{
+    static const SubstringFinder finder = pick_finder();
+    return finder(haystack, size, needle, needle_size);
+}
+
+std::vector<std::pair<std::string, SubstringFinder>> substring_finders()
+{
+    std::vector<std::pair<std::string, SubstringFinder>> finders {{"scalar", find_scalar}};
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        finders.emplace_back("sse2", find_sse2);
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        finders.emplace_back("avx2", find_avx2);
+    }
+#endif
+    return finders;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_SUBSTRINGSCAN_H
+#define MEDIASCANNER_SCOPE_SUBSTRINGSCAN_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// same contract as memmem(): the first occurrence of needle in haystack, or null
+typedef const char* (*SubstringFinder)(const char *haystack, std::size_t size,
+                                       const char *needle, std::size_t needle_size);
+
+/*
+   memmem() for scanning large in-memory columns. On x86 the candidate
+   positions are checked 32 (AVX2) or 16 (SSE2) at a time, comparing the
+   first and the last byte of the needle before comparing the rest.
+   The implementation is picked on first use for the CPU running it.
+*/
+const char* find_substring(const char *haystack, std::size_t size,
+                           const char *needle, std::size_t needle_size);
+
+// name and function of every implementation this CPU can run, the portable one first
+std::vector<std::pair<std::string, SubstringFinder>> substring_finders();
+
+#endif
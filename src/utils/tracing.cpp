@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tracing.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct Event
+{
+    const char *name;
+    int64_t start_us;
+    int64_t duration_us;
+    long tid;
+};
+
+// the writer is woken up once a thread has this many spans, and otherwise writes every second
+const std::size_t FLUSH_EVENTS = 4096;
+const std::chrono::seconds FLUSH_INTERVAL(1);
+
+// spans of one thread; its lock is only ever contended by the writer
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::vector<Event> events;
+};
+
+class TraceFile
+{
+public:
+    static TraceFile& instance()
+    {
+        // never destroyed, so that spans can still be flushed at exit
+        static TraceFile *file = new TraceFile;
+        return *file;
+    }
+
+    void add(Event const& event)
+    {
+        static thread_local std::shared_ptr<ThreadBuffer> buffer = add_buffer();
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            buffer->events.push_back(event);
+            full = buffer->events.size() == FLUSH_EVENTS;
+        }
+        if (full)
+        {
+            start_writer();
+            {
+                std::lock_guard<std::mutex> lock(wakeup_mutex_);
+                wanted_ = true;
+            }
+            wakeup_.notify_one();
+        }
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        write(collect());
+    }
+
+    // joins the writer; a thread recording its first spans or filling its buffer starts it again
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        if (writer_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> wakeup_lock(wakeup_mutex_);
+                stopping_ = true;
+            }
+            wakeup_.notify_one();
+            writer_.join();
+            stopping_ = false;
+        }
+        flush();
+    }
+
+private:
+    TraceFile()
+    {
+        // also runs when a scope module gets unloaded, so the writer never outlives its code
+        atexit([] { TraceFile::instance().stop(); });
+    }
+
+    void start_writer()
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        if (!writer_.joinable())
+        {
+            writer_ = std::thread([this] { run(); });
+        }
+    }
+
+    std::shared_ptr<ThreadBuffer> add_buffer()
+    {
+        start_writer();
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.reserve(FLUSH_EVENTS);
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.push_back(buffer);
+        return buffer;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(wakeup_mutex_);
+        while (!stopping_)
+        {
+            wakeup_.wait_for(lock, FLUSH_INTERVAL, [this] { return stopping_ || wanted_; });
+            wanted_ = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    // takes the spans of all threads, and forgets the buffers of threads that are gone
+    std::vector<Event> collect()
+    {
+        std::vector<Event> events;
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        for (auto it = buffers_.begin(); it != buffers_.end();)
+        {
+            {
+                std::lock_guard<std::mutex> buffer_lock((*it)->mutex);
+                events.insert(events.end(), (*it)->events.begin(), (*it)->events.end());
+                (*it)->events.clear();
+            }
+            it = it->use_count() == 1 ? buffers_.erase(it) : it + 1;
+        }
+        return events;
+    }
+
+    // must be called with write_mutex_ held
+    void write(std::vector<Event> const& events)
+    {
+        if (events.empty())
+        {
+            return;
+        }
+        const char *path = getenv("MEDIASCANNER_TRACE_FILE");
+        FILE *out = path ? fopen(path, "a") : nullptr;
+        if (!out)
+        {
+            std::cerr << "Failed to open trace file " << (path ? path : "") << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        // the JSON array format may be left unterminated, so that it can be appended to
+        if (ftell(out) == 0)
+        {
+            fputs("[\n", out);
+        }
+        const int pid = getpid();
+        for (auto const& event: events)
+        {
+            fprintf(out, "{\"name\":\"%s\",\"cat\":\"mediascanner\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%ld},\n",
+                    event.name, static_cast<long long>(event.start_us), static_cast<long long>(event.duration_us), pid, event.tid);
+        }
+        fclose(out);
+    }
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    std::mutex write_mutex_;
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_;
+    bool wanted_ = false;
+    bool stopping_ = false;
+    std::mutex writer_mutex_;
+    std::thread writer_;
+};
+
+}
+
+bool trace_file_set()
+{
+    return getenv("MEDIASCANNER_TRACE_FILE") != nullptr;
+}
+
+int64_t TraceSpan::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceSpan::record(const char *name, int64_t start_us)
+{
+    static thread_local const long tid = syscall(SYS_gettid);
+    TraceFile::instance().add(Event{name, start_us, now_us() - start_us, tid});
+}
+
+void flush_trace()
+{
+    if (tracing_enabled())
+    {
+        TraceFile::instance().stop();
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_TRACING_H
+#define MEDIASCANNER_SCOPE_TRACING_H
+
+#include <cstdint>
+
+/*
+   Span tracing for finding out where the time of a query goes.
+
+   Tracing is enabled by pointing MEDIASCANNER_TRACE_FILE at a file; spans are
+   then written to it in Chrome trace event format (load it in chrome://tracing).
+   Spans on the same thread nest by time. Each thread records its spans into a
+   buffer of its own, a background thread writes them out. When tracing is
+   disabled, a span costs a single branch on a flag.
+*/
+
+// true if MEDIASCANNER_TRACE_FILE was set when the process started
+bool trace_file_set();
+
+// a function-local static, so that spans in static initializers see it set
+inline bool tracing_enabled()
+{
+    static const bool enabled = trace_file_set();
+    return enabled;
+}
+
+class TraceSpan
+{
+public:
+    // name must be a string literal, or otherwise outlive the span
+    explicit TraceSpan(const char *name)
+        : name_(tracing_enabled() ? name : nullptr),
+          start_us_(name_ ? now_us() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (name_)
+        {
+            record(name_, start_us_);
+        }
+    }
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+private:
+    static int64_t now_us();
+    static void record(const char *name, int64_t start_us);
+
+    const char *name_;
+    const int64_t start_us_;
+};
+
+// writes the spans recorded so far to the trace file, and stops the background
+// writer until spans get recorded again
+void flush_trace();
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "trigramindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+bool is_word_char(unsigned char c)
+{
+    // bytes of multi-byte UTF-8 sequences are taken as they are
+    return c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+unsigned char to_lower(unsigned char c)
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+}
+
+std::uint32_t TrigramIndex::add(std::string const& text)
+{
+    const std::uint32_t id = texts_.size();
+    auto const keys = trigrams(text);
+    for (auto key: keys)
+    {
+        pending_.emplace_back(key, id);
+    }
+    texts_.push_back(text);
+    trigram_counts_.push_back(std::min<std::size_t>(keys.size(), UINT16_MAX));
+    return id;
+}
+
+void TrigramIndex::build()
+{
+    if (!keys_.empty())
+    {
+        throw std::logic_error("TrigramIndex::build(): index is already built");
+    }
+    std::sort(pending_.begin(), pending_.end());
+
+    ids_.reserve(pending_.size());
+    for (auto const& entry: pending_)
+    {
+        if (keys_.empty() || keys_.back() != entry.first)
+        {
+            keys_.push_back(entry.first);
+            offsets_.push_back(ids_.size());
+        }
+        ids_.push_back(entry.second);
+    }
+    offsets_.push_back(ids_.size());
+
+    keys_.shrink_to_fit();
+    offsets_.shrink_to_fit();
+    std::vector<std::pair<std::uint32_t, std::uint32_t>>().swap(pending_);
+}
+
+std::size_t TrigramIndex::size() const
+{
+    return texts_.size();
+}
+
+std::string const& TrigramIndex::text(std::uint32_t id) const
+{
+    return texts_.at(id);
+}
+
+std::vector<TrigramIndex::Match> TrigramIndex::search(std::string const& query, std::size_t max_results,
+        float min_score, std::size_t max_candidates) const
+{
+    auto const query_keys = trigrams(query);
+    if (query_keys.empty() || keys_.empty())
+    {
+        return std::vector<Match>();
+    }
+
+    // count the trigrams every string shares with the query
+    std::vector<std::uint16_t> shared(texts_.size(), 0);
+    std::vector<std::uint32_t> candidates;
+    for (auto key: query_keys)
+    {
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        if (it == keys_.end() || *it != key)
+        {
+            continue;
+        }
+        const std::size_t k = it - keys_.begin();
+        for (std::uint32_t i = offsets_[k]; i < offsets_[k + 1]; i++)
+        {
+            const std::uint32_t id = ids_[i];
+            if (shared[id]++ == 0)
+            {
+                candidates.push_back(id);
+            }
+        }
+    }
+
+    // a Dice coefficient of min_score needs at least this many shared trigrams
+    const float query_count = query_keys.size();
+    const unsigned min_shared = std::max(1.0f, std::ceil(min_score * query_count / 2));
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                [&shared, min_shared](std::uint32_t id) { return shared[id] < min_shared; }),
+            candidates.end());
+    if (candidates.size() > max_candidates)
+    {
+        std::nth_element(candidates.begin(), candidates.begin() + max_candidates, candidates.end(),
+                [&shared](std::uint32_t a, std::uint32_t b) { return shared[a] > shared[b]; });
+        candidates.resize(max_candidates);
+    }
+
+    std::vector<Match> matches;
+    for (auto id: candidates)
+    {
+        const float score = 2.0f * shared[id] / (query_count + trigram_counts_[id]);
+        if (score >= min_score)
+        {
+            matches.push_back(Match{id, score});
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [](Match const& a, Match const& b) {
+        return a.score > b.score || (a.score == b.score && a.id < b.id);
+    });
+    if (matches.size() > max_results)
+    {
+        matches.resize(max_results);
+    }
+    return matches;
+}
+
+std::vector<std::uint32_t> TrigramIndex::trigrams(std::string const& text)
+{
+    std::vector<std::uint32_t> keys;
+    keys.reserve(text.size() + 2);
+
+    // every word is padded as "  word ", like pg_trgm does
+    const std::uint32_t padding = (' ' << 8) | ' ';
+    std::uint32_t key = padding;
+    bool in_word = false;
+    for (std::size_t i = 0; i <= text.size(); i++)
+    {
+        const unsigned char c = i < text.size() ? text[i] : ' ';
+        if (is_word_char(c))
+        {
+            if (!in_word)
+            {
+                key = padding;
+                in_word = true;
+            }
+            key = ((key << 8) | to_lower(c)) & 0xffffff;
+            keys.push_back(key);
+        }
+        else if (in_word)
+        {
+            key = ((key << 8) | ' ') & 0xffffff;
+            keys.push_back(key);
+            in_word = false;
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
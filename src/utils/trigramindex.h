@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_TRIGRAMINDEX_H
+#define MEDIASCANNER_SCOPE_TRIGRAMINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+   Approximate string matching over a fixed set of strings. Strings are
+   compared by the trigrams of their words, so a query still finds the
+   strings it shares most trigrams with when it has a letter missing,
+   swapped or mistyped.
+*/
+class TrigramIndex
+{
+public:
+    struct Match
+    {
+        std::uint32_t id;
+        // Dice coefficient of the trigram sets, between 0 and 1
+        float score;
+    };
+
+    // ids are handed out in order, starting from 0
+    std::uint32_t add(std::string const& text);
+    // needs to be called after the last add() and before searching
+    void build();
+
+    std::size_t size() const;
+    std::string const& text(std::uint32_t id) const;
+
+    // Up to max_results strings scoring at least min_score, best first. Only the
+    // max_candidates strings sharing the most trigrams with the query get scored.
+    std::vector<Match> search(std::string const& query, std::size_t max_results,
+            float min_score = 0.4f, std::size_t max_candidates = 256) const;
+
+    // sorted, distinct trigrams of the lower cased words of text
+    static std::vector<std::uint32_t> trigrams(std::string const& text);
+
+private:
+    std::vector<std::string> texts_;
+    std::vector<std::uint16_t> trigram_counts_;
+    // (trigram, id) pairs added since the last build()
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pending_;
+    // the ids of the strings containing keys_[i] are ids_[offsets_[i]] to ids_[offsets_[i + 1] - 1]
+    std::vector<std::uint32_t> keys_;
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> ids_;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "typeaheadcache.h"
+#include "metrics.h"
+
+using namespace mediascanner;
+
+namespace
+{
+
+bool is_word_char(unsigned char c)
+{
+    // bytes of multibyte characters are letters too
+    return c >= 0x80 || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+// The words of text as the store matches them, ASCII lower cased and separated by single spaces.
+void append_words(std::string& words, std::string const& text)
+{
+    bool in_word = false;
+    for (unsigned char c: text)
+    {
+        if (!is_word_char(c))
+        {
+            in_word = false;
+            continue;
+        }
+        if (!in_word && !words.empty())
+        {
+            words.push_back(' ');
+        }
+        in_word = true;
+        words.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+}
+
+std::string words_of(std::string const& text)
+{
+    std::string words;
+    append_words(words, text);
+    return words;
+}
+
+bool starts_a_word(std::string const& words, std::string const& word)
+{
+    for (std::size_t pos = words.find(word); pos != std::string::npos; pos = words.find(word, pos + 1))
+    {
+        if (pos == 0 || words[pos - 1] == ' ')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// whether the query with words key only makes the last word of the one with words base longer
+bool extends_last_word(std::string const& key, std::string const& base)
+{
+    return !base.empty() && key.size() > base.size() && key.compare(0, base.size(), base) == 0 &&
+        key.find(' ', base.size()) == std::string::npos;
+}
+
+}
+
+TypeAheadCache::TypeAheadCache(std::string const& scope, std::size_t capacity)
+    : capacity_(capacity),
+      hits_(metrics::counter("mediascanner_type_ahead_total", "scope=\"" + scope + "\",result=\"hit\"")),
+      misses_(metrics::counter("mediascanner_type_ahead_total", "scope=\"" + scope + "\",result=\"miss\""))
+{
+}
+
+TypeAheadCache::Candidates TypeAheadCache::refine(std::string const& query, std::uint64_t generation, bool *complete)
+{
+    const std::string key = words_of(query);
+    Candidates base;
+    Keys base_keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::size_t longest = 0;
+        for (auto const& entry: entries_)
+        {
+            if (entry.generation != generation)
+            {
+                continue;
+            }
+            // the same search again gets what the store gave, cut off or not
+            if (entry.key == key)
+            {
+                hits_.inc();
+                if (complete)
+                {
+                    *complete = entry.complete;
+                }
+                return entry.candidates;
+            }
+            if (entry.complete && entry.key.size() > longest && extends_last_word(key, entry.key))
+            {
+                base = entry.candidates;
+                base_keys = entry.keys;
+                longest = entry.key.size();
+            }
+        }
+    }
+    if (!base)
+    {
+        misses_.inc();
+        return base;
+    }
+
+    // the earlier words matched already
+    const std::string last_word = key.substr(key.rfind(' ') + 1);
+    std::vector<MediaFile> refined;
+    std::vector<std::string> refined_keys;
+    for (std::size_t i = 0; i < base->size(); i++)
+    {
+        if (starts_a_word((*base_keys)[i], last_word))
+        {
+            refined.push_back((*base)[i]);
+            refined_keys.push_back((*base_keys)[i]);
+        }
+    }
+    hits_.inc();
+    if (complete)
+    {
+        *complete = true;
+    }
+
+    return insert_entry(key, generation, std::make_shared<const std::vector<MediaFile>>(std::move(refined)),
+                  std::make_shared<const std::vector<std::string>>(std::move(refined_keys)), true);
+}
+
+TypeAheadCache::Candidates TypeAheadCache::insert(std::string const& query, std::uint64_t generation,
+                                                  std::vector<MediaFile> candidates, bool complete)
+{
+    std::vector<std::string> keys;
+    keys.reserve(candidates.size());
+    for (auto const& media: candidates)
+    {
+        std::string words;
+        append_words(words, media.getTitle());
+        append_words(words, media.getAuthor());
+        append_words(words, media.getAlbum());
+        keys.push_back(std::move(words));
+    }
+    return insert_entry(words_of(query), generation, std::make_shared<const std::vector<MediaFile>>(std::move(candidates)),
+                  std::make_shared<const std::vector<std::string>>(std::move(keys)), complete);
+}
+
+TypeAheadCache::Candidates TypeAheadCache::insert_entry(std::string const& key, std::uint64_t generation,
+                                                        Candidates candidates, Keys keys, bool complete)
+{
+    // an empty key matches everything, so there's nothing to refine
+    if (key.empty())
+    {
+        return candidates;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+        if (it->key == key)
+        {
+            entries_.erase(it);
+            break;
+        }
+    }
+    entries_.push_front(Entry{key, generation, candidates, std::move(keys), complete});
+    if (entries_.size() > capacity_)
+    {
+        entries_.pop_back();
+    }
+    return candidates;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_TYPEAHEADCACHE_H
+#define MEDIASCANNER_SCOPE_TYPEAHEADCACHE_H
+
+#include <mediascanner/MediaFile.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Counter;
+
+/*
+   The songs or videos found by the last few full text searches of a scope.
+   Every keystroke is a new search, but one that only makes the last word of
+   an earlier search longer, like "spid" after "spi", can only find what that
+   search found. So when the earlier list was complete, rather than cut off at
+   the result limit, the new one is that list filtered.
+
+   The filter matches like the store does: every word of the query has to
+   start a word of the title, artist or album, ignoring ASCII case but not
+   diacritics. The filtered list keeps the order of the earlier search.
+*/
+class TypeAheadCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<mediascanner::MediaFile>> Candidates;
+
+    // scope labels the hit and miss counters
+    explicit TypeAheadCache(std::string const& scope, std::size_t capacity = 4);
+
+    // The cached list for query, else what is left of the longest complete cached list of
+    // a query whose last word query makes longer, else null. generation is a media_db_generation().
+    // complete, if given, is set to whether the list holds every match rather than being cut off.
+    Candidates refine(std::string const& query, std::uint64_t generation, bool *complete = nullptr);
+
+    // complete is false when the list got cut off at the result limit
+    Candidates insert(std::string const& query, std::uint64_t generation,
+                std::vector<mediascanner::MediaFile> candidates, bool complete);
+
+private:
+    typedef std::shared_ptr<const std::vector<std::string>> Keys;
+
+    struct Entry
+    {
+        std::string key;
+        std::uint64_t generation;
+        Candidates candidates;
+        // per candidate, the words of its title, artist and album as the store matches them
+        Keys keys;
+        bool complete;
+    };
+
+    Candidates insert_entry(std::string const& key, std::uint64_t generation, Candidates candidates, Keys keys, bool complete);
+
+    const std::size_t capacity_;
+    Counter& hits_;
+    Counter& misses_;
+    std::mutex mutex_;
+    // most recent first
+    std::deque<Entry> entries_;
+};
+
+#endif
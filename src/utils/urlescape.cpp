@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "urlescape.h"
+
+namespace
+{
+
+bool unreserved(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+        c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+}
+
+std::string url_escape(std::string const& text)
+{
+    std::string escaped;
+    append_url_escaped(escaped, text);
+    return escaped;
+}
+
+void append_url_escaped(std::string& out, std::string const& text)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    out.reserve(out.size() + text.size());
+    for (unsigned char c: text)
+    {
+        if (unreserved(c))
+        {
+            out.push_back(c);
+        }
+        else
+        {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_URLESCAPE_H
+#define MEDIASCANNER_SCOPE_URLESCAPE_H
+
+#include <string>
+
+// Percent-encodes all but the unreserved characters of RFC 3986, giving what
+// core::net::http::Client::url_escape() gives without a round trip through curl.
+std::string url_escape(std::string const& text);
+
+// the same, appended to out
+void append_url_escaped(std::string& out, std::string const& text);
+
+#endif
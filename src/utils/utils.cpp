@@ -19,6 +19,7 @@
 
 #include "utils.h"
 #include <algorithm>
+#include <cstdlib>
 #include <unity/scopes/ScopeMetadata.h>
 
 unity::scopes::ChildScopeList find_child_scopes_by_keywords(
@@ -57,3 +58,71 @@ unity::scopes::ChildScopeList find_child_scopes_by_keywords(
     }
     return list;
 }
+
+std::size_t aggregator_early_results()
+{
+    const char *value = getenv("MEDIASCANNER_AGGREGATOR_TOP_K");
+    if (value == nullptr)
+    {
+        return 0;
+    }
+    const long top_k = strtol(value, nullptr, 10);
+    return top_k > 0 ? top_k : 0;
+}
+
+bool fuzzy_search_enabled()
+{
+    const char *value = getenv("MEDIASCANNER_FUZZY_SEARCH");
+    return value != nullptr && std::string(value) != "0";
+}
+
+bool result_cache_enabled()
+{
+    const char *value = getenv("MEDIASCANNER_RESULT_CACHE");
+    return value == nullptr || std::string(value) != "0";
+}
+
+bool type_ahead_enabled()
+{
+    const char *value = getenv("MEDIASCANNER_TYPE_AHEAD");
+    return value == nullptr || std::string(value) != "0";
+}
+
+std::size_t embedded_album_tracks()
+{
+    const char *value = getenv("MEDIASCANNER_EMBED_ALBUM_TRACKS");
+    if (value == nullptr)
+    {
+        return 0;
+    }
+    const long albums = strtol(value, nullptr, 10);
+    return albums > 0 ? albums : 0;
+}
+
+bool unified_search_enabled()
+{
+    const char *value = getenv("MEDIASCANNER_UNIFIED_SEARCH");
+    return value == nullptr || std::string(value) != "0";
+}
+
+std::size_t query_workers()
+{
+    const char *value = getenv("MEDIASCANNER_QUERY_WORKERS");
+    if (value == nullptr)
+    {
+        return 0;
+    }
+    const long workers = strtol(value, nullptr, 10);
+    return workers > 0 ? workers : 0;
+}
+
+std::size_t store_connections(std::size_t workers)
+{
+    const char *value = getenv("MEDIASCANNER_STORE_CONNECTIONS");
+    if (value == nullptr)
+    {
+        return 4 + workers;
+    }
+    const long connections = strtol(value, nullptr, 10);
+    return connections > 0 ? connections : 1;
+}
@@ -32,4 +32,44 @@ unity::scopes::ChildScopeList find_child_scopes_by_keywords(
         std::vector<std::string> const& predefined_scopes,
         std::string const& keyword);
 
+// Number of results each child scope may show before the children ahead of it
+// have finished, from MEDIASCANNER_AGGREGATOR_TOP_K. 0 keeps the output strictly
+// ordered child by child.
+std::size_t aggregator_early_results();
+
+// Whether searches matching nothing are retried with the closest name in the
+// library, misspelt ones included. Off unless MEDIASCANNER_FUZZY_SEARCH is set to
+// something other than 0; without it, they are only retried with a name that
+// matches regardless of case and diacritics.
+bool fuzzy_search_enabled();
+
+// Whether queries that ran before get replayed from the result cache. On
+// unless MEDIASCANNER_RESULT_CACHE is 0, which runs every query against the
+// store again, as before the cache.
+bool result_cache_enabled();
+
+// Whether searches extending an earlier one get their songs or videos by filtering
+// what that one found. On unless MEDIASCANNER_TYPE_AHEAD is 0.
+bool type_ahead_enabled();
+
+// Number of album results per query that carry their track list, so that their
+// preview doesn't need the store, from MEDIASCANNER_EMBED_ALBUM_TRACKS. 0 (the
+// default) embeds none.
+std::size_t embedded_album_tracks();
+
+// Whether searches matching fewer songs than they show find their artists and
+// albums in the scan for their songs. On unless MEDIASCANNER_UNIFIED_SEARCH is 0.
+bool unified_search_enabled();
+
+// Number of worker threads running the independent store queries of a query side
+// by side, from MEDIASCANNER_QUERY_WORKERS. 0 (the default) runs them one after another.
+std::size_t query_workers();
+
+// Number of read-only store connections kept open for the queries and previews
+// that run at the same time, from MEDIASCANNER_STORE_CONNECTIONS. By default one
+// per worker thread, whose sub-queries check one out each, plus 4 for the queries
+// themselves: the scope runtime doesn't tell a scope how many threads it runs
+// queries on. Queries beyond that open a connection of their own while they run.
+std::size_t store_connections(std::size_t workers);
+
 #endif
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEDIASCANNER_SCOPE_WORKERPOOL_H
+#define MEDIASCANNER_SCOPE_WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+   A fixed number of threads running the independent parts of queries, such
+   as the artist, album and song searches of a music search, side by side.
+   The jobs bring their own store connections, checked out of the scope's
+   StorePool, so that they don't take turns on one SQLite connection.
+*/
+class WorkerPool
+{
+public:
+    explicit WorkerPool(std::size_t threads);
+    // runs the jobs already submitted, then joins the workers
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+
+    // the future rethrows what job threw
+    std::future<void> submit(std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_ = false;
+    std::deque<std::packaged_task<void()>> jobs_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
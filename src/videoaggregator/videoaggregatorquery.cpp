@@ -34,6 +34,11 @@
 #include "videoaggregatorquery.h"
 #include "videoaggregatorscope.h"
 #include "../utils/bufferedresultforwarder.h"
+#include "../utils/metrics.h"
+#include "../utils/tracing.h"
+#ifdef LOCAL_SCOPES_IN_PROCESS
+#include "../myvideos/video-scope.h"
+#endif
 
 using namespace unity::scopes;
 
@@ -76,25 +81,45 @@ static char SEARCH_CATEGORY_DEFINITION[] = R"(
 }
 )";
 
-VideoAggregatorQuery::VideoAggregatorQuery(CannedQuery const& query, SearchMetadata const& hints, ChildScopeList const& scopes) :
+VideoAggregatorQuery::VideoAggregatorQuery(CannedQuery const& query, SearchMetadata const& hints, ChildScopeList const& scopes,
+        std::shared_ptr<VideoScope> const& local_scope, std::size_t early_results) :
     SearchQueryBase(query, hints),
-    child_scopes(scopes) {
+    child_scopes(scopes),
+    local_scope(local_scope),
+    early_results(early_results),
+    local_cancelled(false) {
         std::reverse(child_scopes.begin(), child_scopes.end());
 }
 
 VideoAggregatorQuery::~VideoAggregatorQuery() {
+    if (local_thread.joinable()) {
+        local_thread.join();
+    }
 }
 
 void VideoAggregatorQuery::cancelled() {
+    static Counter& cancellations = metrics::counter("mediascanner_queries_cancelled_total", "scope=\"videoaggregator\"");
+    cancellations.inc();
+    subsearches.cancel();
+
+    local_cancelled = true;
+    std::lock_guard<std::mutex> lock(local_mutex);
+    if (local_query) {
+        local_query->cancelled();
+    }
 }
 
 void VideoAggregatorQuery::run(unity::scopes::SearchReplyProxy const& parent_reply) {
+    TraceSpan span("VideoAggregatorQuery::run");
+    static Counter& queries = metrics::counter("mediascanner_queries_total", "scope=\"videoaggregator\"");
+    queries.inc();
     const std::string query_string = query().query_string();
     const bool surfacing = query_string.empty();
     const std::string department_id = "aggregated:videoaggregator"; //FIXME: remove when child scopes handle is_aggregated
-    const FilterState filter_state;
 
     unity::scopes::utility::BufferedResultForwarder::SPtr next_forwarder;
+    std::function<void()> local_search;
+    auto const timer = std::make_shared<FirstResultTimer>("videoaggregator", early_results > 0 ? "interleaved" : "ordered");
 
     //
     // maps scope id to category id of first received result from that scope.
@@ -157,7 +182,67 @@ void VideoAggregatorQuery::run(unity::scopes::SearchReplyProxy const& parent_rep
                         return false; // filter out results from other categories
                     });
             }
-            subsearch(child, query_string, department_id, filter_state, next_forwarder);
+            auto const forwarder = std::static_pointer_cast<BufferedResultForwarder>(next_forwarder);
+            forwarder->set_early_results(early_results);
+            forwarder->set_first_result_timer(timer);
+            forwarder->set_child_metrics("videoaggregator", child_id);
+
+            if (local_scope && child_id == VideoAggregatorScope::local_videos_scope)
+            {
+                // search local videos in this process once the other subsearches are on their way
+                auto const reply = next_forwarder;
+                local_search = [this, child, department_id, reply, parent_reply]() {
+                    search_in_process(child, department_id, reply, parent_reply);
+                };
+                continue;
+            }
+
+            // identical subsearches of concurrent queries (e.g. when the dash gets reopened) share one child query
+            subsearches.subsearch(child, query_string, department_id, search_metadata(), next_forwarder,
+                [this, child, query_string, department_id](SearchListenerBase::SPtr const& listener) {
+                    const FilterState filter_state;
+                    return subsearch(child, query_string, department_id, filter_state, listener);
+                });
+        }
+    }
+
+    if (local_search) {
+        local_thread = std::thread(local_search);
+    }
+}
+
+void VideoAggregatorQuery::search_in_process(ChildScope const& child, std::string const& department_id,
+        SearchListenerBase::SPtr const& reply, SearchReplyProxy const& parent_reply)
+{
+#ifdef LOCAL_SCOPES_IN_PROCESS
+    TraceSpan span("VideoAggregatorQuery::search_in_process");
+    SearchMetadata local_metadata(search_metadata());
+    local_metadata.set_aggregated_keywords(child.keywords);
+
+    // categories get registered directly with the parent reply, results go through the forwarder
+    // so that they keep their position in the aggregated output
+    auto const local = std::make_shared<VideoQuery>(*local_scope, CannedQuery(child.id, query().query_string(), department_id), local_metadata);
+    {
+        // cancelled() reaches the local query from now on
+        std::lock_guard<std::mutex> lock(local_mutex);
+        if (local_cancelled)
+        {
+            reply->finished(CompletionDetails(CompletionDetails::Cancelled));
+            return;
         }
+        local_query = local;
+    }
+    try
+    {
+        local->run_in_process(parent_reply, [this, &reply](CategorisedResult const& result) -> bool {
+                reply->push(result);
+                return valid() && !local_cancelled;
+            });
+        reply->finished(CompletionDetails(local_cancelled ? CompletionDetails::Cancelled : CompletionDetails::OK));
+    }
+    catch (const std::exception& e)
+    {
+        reply->finished(CompletionDetails(CompletionDetails::Error, e.what()));
     }
+#endif
 }
@@ -24,19 +24,45 @@
 #include <unity/scopes/SearchQueryBase.h>
 #include <unity/scopes/ReplyProxyFwd.h>
 
+#include "../utils/inflightsearches.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class VideoScope;
+
 class VideoAggregatorQuery : public unity::scopes::SearchQueryBase
 {
 public:
     VideoAggregatorQuery(unity::scopes::CannedQuery const& query,
             unity::scopes::SearchMetadata const& hints,
-            unity::scopes::ChildScopeList const& scopes);
+            unity::scopes::ChildScopeList const& scopes,
+            std::shared_ptr<VideoScope> const& local_scope = nullptr,
+            std::size_t early_results = 0);
     ~VideoAggregatorQuery();
     virtual void cancelled() override;
 
     virtual void run(unity::scopes::SearchReplyProxy const& reply) override;
 
 private:
+    void search_in_process(unity::scopes::ChildScope const& child,
+            std::string const& department_id,
+            unity::scopes::SearchListenerBase::SPtr const& reply,
+            unity::scopes::SearchReplyProxy const& parent_reply);
+
     unity::scopes::ChildScopeList child_scopes;
+    // kept here, so that the local query outlives a stop() of the aggregator
+    std::shared_ptr<VideoScope> local_scope;
+    std::size_t early_results;
+    CoalescedSearches subsearches;
+
+    // the in-process local query runs on a thread of its own, so that run() doesn't wait for it
+    std::thread local_thread;
+    std::mutex local_mutex;
+    std::shared_ptr<unity::scopes::SearchQueryBase> local_query;
+    std::atomic<bool> local_cancelled;
 };
 
 #endif
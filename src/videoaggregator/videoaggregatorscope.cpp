@@ -25,6 +25,13 @@
 #include <unity/scopes/CategoryRenderer.h>
 #include "../utils/utils.h"
 #include "../utils/i18n.h"
+#include "../utils/firstresulttimer.h"
+#include "../utils/metrics.h"
+#include "../utils/tracing.h"
+#include <iostream>
+#ifdef LOCAL_SCOPES_IN_PROCESS
+#include "../myvideos/video-scope.h"
+#endif
 
 using namespace unity::scopes;
 
@@ -44,6 +51,22 @@ const std::vector<std::string> VideoAggregatorScope::predefined_scopes {
 
 void VideoAggregatorScope::start(std::string const&) {
     init_gettext(*this);
+    early_results = aggregator_early_results();
+    metrics::start_export();
+#ifdef LOCAL_SCOPES_IN_PROCESS
+    try
+    {
+        auto const dir = registry()->get_metadata(local_videos_scope).scope_directory();
+        local_scope = std::make_shared<VideoScope>();
+        local_scope->start_in_process(dir);
+    }
+    catch (const std::exception& e)
+    {
+        // fall back to querying the local scope over IPC
+        std::cerr << "Failed to start " << local_videos_scope << " in process: " << e.what() << std::endl;
+        local_scope.reset();
+    }
+#endif
 }
 
 ChildScopeList VideoAggregatorScope::find_child_scopes() const
@@ -52,11 +75,15 @@ ChildScopeList VideoAggregatorScope::find_child_scopes() const
 }
 
 void VideoAggregatorScope::stop() {
+    local_scope.reset();
+    FirstResultTimer::log_summary(std::cerr, "videoaggregator");
+    metrics::stop_export();
+    flush_trace();
 }
 
 SearchQueryBase::UPtr VideoAggregatorScope::search(CannedQuery const& q,
                                                    SearchMetadata const& hints) {
-    SearchQueryBase::UPtr query(new VideoAggregatorQuery(q, hints, child_scopes()));
+    SearchQueryBase::UPtr query(new VideoAggregatorQuery(q, hints, child_scopes(), local_scope, early_results));
     return query;
 }
 
@@ -20,12 +20,15 @@
 #ifndef VIDEOAGGREGATORSCOPE_H
 #define VIDEOAGGREGATORSCOPE_H
 
+#include <memory>
 #include <vector>
 
 #include <unity/scopes/ScopeBase.h>
 #include <unity/scopes/ScopeMetadata.h>
 #include <unity/scopes/ReplyProxyFwd.h>
 
+class VideoScope;
+
 class VideoAggregatorScope : public unity::scopes::ScopeBase
 {
 public:
@@ -43,6 +46,12 @@ public:
 
     static const std::string local_videos_scope;
     static const std::vector<std::string> predefined_scopes;
+
+private:
+    // local video scope running in this process, if LOCAL_SCOPES_IN_PROCESS is enabled
+    std::shared_ptr<VideoScope> local_scope;
+    // results each child may show ahead of its turn, 0 for strictly ordered output
+    std::size_t early_results = 0;
 };
 
 #endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <mediascanner/MediaStore.hh>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "../benchmarks/allocation-counter.h"
+#include "../benchmarks/synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+#include "../src/myvideos/video-scope.h"
+
+using namespace mediascanner;
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Return;
+
+/*
+   Heap allocations made by a query per result it produces, measured with
+   global operator new/delete hooks. Only the thread running the query is
+   counted, so the catalogue and store connections the scope opens in the
+   background don't make the numbers vary from run to run. The limits are
+   about twice the allocations a result takes on its way out: a result that
+   starts copying something the size of the library fails the test, noise
+   doesn't. When a change moves a query's printed value a lot, move its
+   limit along in the same change.
+*/
+
+namespace
+{
+
+const int TRACKS = 1000;
+const int VIDEOS = 300;
+const int RUNS = 3;
+
+struct Allocations
+{
+    double per_result;
+    double bytes_per_result;
+};
+
+// runs the query a few times after a warm up run, results go to a counting sink
+template<typename Query, typename Scope>
+Allocations measure(Scope& scope, CannedQuery const& q, SearchMetadata const& hints)
+{
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Return(category));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+    std::size_t results = 0;
+    auto sink = [&results](CategorisedResult const&) {
+        results++;
+        return true;
+    };
+
+    {
+        auto query = scope.search(q, hints);
+        dynamic_cast<Query&>(*query).run_in_process(proxy, sink);
+    }
+
+    results = 0;
+    AllocationCounter counter;
+    for (int i = 0; i < RUNS; i++)
+    {
+        auto query = scope.search(q, hints);
+        dynamic_cast<Query&>(*query).run_in_process(proxy, sink);
+    }
+    counter.stop();
+
+    if (results == 0)
+    {
+        throw std::runtime_error("query '" + q.query_string() + "' in department '" + q.department_id() + "' found nothing");
+    }
+    Allocations a;
+    a.per_result = double(counter.allocations()) / results;
+    a.bytes_per_result = double(counter.bytes()) / results;
+    printf("%-20s %-12s %-8s %8.1f allocations %10.0f bytes per result\n",
+           q.scope_id().c_str(), q.department_id().c_str(), q.query_string().c_str(),
+           a.per_result, a.bytes_per_result);
+    return a;
+}
+
+SearchMetadata aggregated_hints()
+{
+    SearchMetadata hints("en_AU", "phone");
+    hints.set_aggregated_keywords(std::set<std::string>());
+    return hints;
+}
+
+std::string make_cachedir()
+{
+    std::string cachedir = "/tmp/mediastore.XXXXXX";
+    // mkdtemp edits the string in place without changing its length
+    if (mkdtemp(const_cast<char*>(cachedir.c_str())) == nullptr) {
+        throw std::runtime_error(strerror(errno));
+    }
+    if (setenv("MEDIASCANNER_CACHEDIR", cachedir.c_str(), 1) != 0) {
+        throw std::runtime_error(strerror(errno));
+    }
+    // every run has to build its results, rather than replay the first run's
+    if (setenv("MEDIASCANNER_RESULT_CACHE", "0", 1) != 0) {
+        throw std::runtime_error(strerror(errno));
+    }
+    // sub-queries run on the measured thread
+    if (setenv("MEDIASCANNER_QUERY_WORKERS", "0", 1) != 0) {
+        throw std::runtime_error(strerror(errno));
+    }
+    MediaStore store(MS_READ_WRITE);
+    populate_synthetic_library(store, TRACKS, VIDEOS);
+    return cachedir;
+}
+
+void remove_cachedir(std::string const& cachedir)
+{
+    std::string cmd = "rm -rf " + cachedir;
+    ASSERT_EQ(0, system(cmd.c_str()));
+}
+
+}
+
+class MusicAllocationTest : public unity::scopes::testing::TypedScopeFixture<MusicScope> {
+protected:
+    virtual void SetUp() {
+        cachedir = make_cachedir();
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+
+    virtual void TearDown() {
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::TearDown();
+        remove_cachedir(cachedir);
+    }
+
+    Allocations measure(CannedQuery const& q, SearchMetadata const& hints = SearchMetadata("en_AU", "phone")) {
+        return ::measure<MusicQuery>(*scope, q, hints);
+    }
+
+    std::string cachedir;
+};
+
+class VideoAllocationTest : public unity::scopes::testing::TypedScopeFixture<VideoScope> {
+protected:
+    virtual void SetUp() {
+        cachedir = make_cachedir();
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<VideoScope>::SetUp();
+    }
+
+    virtual void TearDown() {
+        unity::scopes::testing::TypedScopeFixture<VideoScope>::TearDown();
+        remove_cachedir(cachedir);
+    }
+
+    Allocations measure(CannedQuery const& q, SearchMetadata const& hints = SearchMetadata("en_AU", "phone")) {
+        return ::measure<VideoQuery>(*scope, q, hints);
+    }
+
+    std::string cachedir;
+};
+
+TEST_F(MusicAllocationTest, Tracks) {
+    // a song and its window of the playlist
+    EXPECT_LT(measure(CannedQuery("mediascanner-music", "", "tracks")).per_result, 360);
+}
+
+TEST_F(MusicAllocationTest, Albums) {
+    EXPECT_LT(measure(CannedQuery("mediascanner-music", "", "albums")).per_result, 75);
+}
+
+TEST_F(MusicAllocationTest, Search) {
+    EXPECT_LT(measure(CannedQuery("mediascanner-music", "love", "")).per_result, 100);
+}
+
+TEST_F(MusicAllocationTest, AggregatedSurfacing) {
+    // every song carries a window of the playlist
+    EXPECT_LT(measure(CannedQuery("mediascanner-music", "", ""), aggregated_hints()).per_result, 360);
+}
+
+TEST_F(VideoAllocationTest, Surfacing) {
+    EXPECT_LT(measure(CannedQuery("mediascanner-video", "", "")).per_result, 90);
+}
+
+TEST_F(VideoAllocationTest, Search) {
+    EXPECT_LT(measure(CannedQuery("mediascanner-video", "love", "")).per_result, 90);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
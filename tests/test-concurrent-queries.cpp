@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <mediascanner/MediaStore.hh>
+#include <unity/scopes/ActionMetadata.h>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockPreviewReply.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "../benchmarks/synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+
+using namespace mediascanner;
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Matcher;
+
+/*
+   Many searches and previews running at once, each on a store connection
+   of its own, have to give what they give when run one after another. The
+   rates of both are printed, not checked. Build with -DTHREAD_SANITIZER=ON
+   to have the scope's shared caches checked for data races along the way.
+*/
+
+namespace
+{
+
+const int THREADS = 4;
+const int ROUNDS = 3;
+
+// the category and uri of each search result, or the sources of a preview's tracks
+typedef std::vector<std::string> Outcome;
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+class ConcurrentQueriesTest : public unity::scopes::testing::TypedScopeFixture<MusicScope> {
+protected:
+    virtual void SetUp() {
+        cachedir = "/tmp/mediastore.XXXXXX";
+        // mkdtemp edits the string in place without changing its length
+        if (mkdtemp(const_cast<char*>(cachedir.c_str())) == nullptr) {
+            throw std::runtime_error(strerror(errno));
+        }
+        ASSERT_EQ(0, setenv("MEDIASCANNER_CACHEDIR", cachedir.c_str(), 1));
+        {
+            MediaStore store(MS_READ_WRITE);
+            populate_synthetic_library(store, 2000, 0);
+        }
+        // every query has to get to the store, some of them with workers of their own
+        ASSERT_EQ(0, setenv("MEDIASCANNER_RESULT_CACHE", "0", 1));
+        ASSERT_EQ(0, setenv("MEDIASCANNER_TYPE_AHEAD", "0", 1));
+        ASSERT_EQ(0, setenv("MEDIASCANNER_QUERY_WORKERS", "2", 1));
+        // fewer than the threads, so that some queries open an extra connection
+        ASSERT_EQ(0, setenv("MEDIASCANNER_STORE_CONNECTIONS", "2", 1));
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+
+    virtual void TearDown() {
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::TearDown();
+        unsetenv("MEDIASCANNER_RESULT_CACHE");
+        unsetenv("MEDIASCANNER_TYPE_AHEAD");
+        unsetenv("MEDIASCANNER_QUERY_WORKERS");
+        unsetenv("MEDIASCANNER_STORE_CONNECTIONS");
+        std::string cmd = "rm -rf " + cachedir;
+        ASSERT_EQ(0, system(cmd.c_str()));
+    }
+
+    std::vector<CategorisedResult> run_search(CannedQuery const& q) {
+        auto query = scope->search(q, SearchMetadata("en_AU", "phone"));
+        return run_query(*query);
+    }
+
+    std::vector<CategorisedResult> run_query(SearchQueryBase& query) {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Invoke([](std::string const& id, std::string const& title, std::string const& icon, CategoryRenderer const& renderer) {
+                        return Category::SCPtr(std::make_shared<unity::scopes::testing::Category>(id, title, icon, renderer));
+                    }));
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+        std::vector<CategorisedResult> results;
+        dynamic_cast<MusicQuery&>(query).run_in_process(proxy, [&results](CategorisedResult const& result) {
+                results.push_back(result);
+                return true;
+            });
+        return results;
+    }
+
+    Outcome search(CannedQuery const& q) {
+        Outcome outcome;
+        for (auto const& result: run_search(q)) {
+            outcome.push_back(result.category()->id() + " " + result.uri());
+        }
+        return outcome;
+    }
+
+    Outcome preview(Result const& album) {
+        Outcome outcome;
+        ::testing::NiceMock<unity::scopes::testing::MockPreviewReply> reply;
+        ON_CALL(reply, push(Matcher<PreviewWidgetList const&>(_)))
+            .WillByDefault(Invoke([&outcome](PreviewWidgetList const& widgets) {
+                        for (auto const& widget: widgets) {
+                            if (widget.id() != "tracks") {
+                                continue;
+                            }
+                            for (auto const& track: widget.attribute_values().at("tracks").get_array()) {
+                                outcome.push_back(track.get_dict().at("source").get_string());
+                            }
+                        }
+                        return true;
+                    }));
+        PreviewReplyProxy proxy(&reply, [](PreviewReply*){});
+        auto previewer = scope->preview(album, ActionMetadata("en_AU", "phone"));
+        previewer->run(proxy);
+        return outcome;
+    }
+
+    std::string cachedir;
+};
+
+TEST_F(ConcurrentQueriesTest, SameResultsAsSerial) {
+    std::vector<CannedQuery> queries;
+    for (std::size_t i = 0; i < 8; i++) {
+        queries.emplace_back("mediascanner-music", synthetic_words[i], "");
+    }
+    queries.emplace_back("mediascanner-music", "", "albums");
+    queries.emplace_back("mediascanner-music", "", "tracks");
+    CannedQuery artist("mediascanner-music", synthetic_top_artist, "");
+    artist.set_user_data(Variant("albums_of_artist"));
+    queries.push_back(artist);
+
+    auto albums = run_search(CannedQuery("mediascanner-music", "", "albums"));
+    ASSERT_FALSE(albums.empty());
+    if (albums.size() > 12) {
+        albums.erase(albums.begin() + 12, albums.end());
+    }
+
+    const std::size_t jobs = queries.size() + albums.size();
+    auto run_job = [&](std::size_t i) {
+        return i < queries.size() ? search(queries[i]) : preview(albums[i - queries.size()]);
+    };
+
+    // the first round warms the caches up and gives the expected outcomes
+    std::vector<Outcome> expected;
+    for (std::size_t i = 0; i < jobs; i++) {
+        expected.push_back(run_job(i));
+        EXPECT_FALSE(expected.back().empty()) << "job " << i;
+    }
+    auto const serial_start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (std::size_t i = 0; i < jobs; i++) {
+            EXPECT_EQ(expected[i], run_job(i)) << "job " << i;
+        }
+    }
+    const double serial_ms = elapsed_ms(serial_start);
+
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+    auto const concurrent_start = std::chrono::steady_clock::now();
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+                // each thread starts somewhere else, so that all kinds of job overlap
+                for (int round = 0; round < ROUNDS; round++) {
+                    for (std::size_t k = 0; k < jobs; k++) {
+                        const std::size_t i = (k + t * jobs / THREADS) % jobs;
+                        if (run_job(i) != expected[i]) {
+                            mismatches++;
+                        }
+                    }
+                }
+            });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    const double concurrent_ms = elapsed_ms(concurrent_start);
+    EXPECT_EQ(0, mismatches);
+
+    // only for reading: how fast a loaded machine runs them says nothing about correctness
+    const double serial_rate = ROUNDS * jobs * 1000.0 / serial_ms;
+    const double concurrent_rate = THREADS * ROUNDS * jobs * 1000.0 / concurrent_ms;
+    printf("serial %.1f jobs/s, %d threads %.1f jobs/s (%.2fx)\n",
+           serial_rate, THREADS, concurrent_rate, concurrent_rate / serial_rate);
+}
+
+TEST_F(ConcurrentQueriesTest, QueryOutlivesStop) {
+    CannedQuery q("mediascanner-music", synthetic_words[0], "");
+    const Outcome expected = search(q);
+    ASSERT_FALSE(expected.empty());
+
+    // the query keeps the workers, connections and snapshots the scope lets go of
+    auto query = scope->search(q, SearchMetadata("en_AU", "phone"));
+    scope->stop();
+    Outcome outcome;
+    for (auto const& result: run_query(*query)) {
+        outcome.push_back(result.category()->id() + " " + result.uri());
+    }
+    EXPECT_EQ(expected, outcome);
+
+    query.reset();
+    scope->start_in_process("/no/such/directory");
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
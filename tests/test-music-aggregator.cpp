@@ -17,7 +17,10 @@
 
 using namespace unity::scopes;
 using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Matcher;
 using ::testing::Return;
+using ::testing::SaveArg;
 
 TEST(TestMusicAgregator, TestSurfacingSearch) {
 
@@ -168,6 +171,121 @@ TEST(TestMusicAgregator, TestSpecificSearch) {
     query.run(proxy);
 }
 
+TEST(TestMusicAgregator, TestCoalescedSearch) {
+
+    CannedQuery q("mediascanner-music", "coalesced", "");
+    SearchMetadata hints("en_AU", "phone");
+
+    std::shared_ptr<unity::scopes::testing::MockScope> soundcloud_scope(new unity::scopes::testing::MockScope("2", "2"));
+    std::shared_ptr<unity::scopes::testing::MockScope> local_scope(new unity::scopes::testing::MockScope("6", "6"));
+
+    unity::scopes::ChildScopeList child_scopes {
+        {"mediascanner-music", unity::scopes::testing::ScopeMetadataBuilder()
+            .scope_id("mediascanner-music")
+                .display_name(" ").description(" ")
+                .author(" ")
+                .proxy(unity::scopes::ScopeProxy(local_scope))()},
+        {"com.ubuntu.scopes.soundcloud_soundcloud", unity::scopes::testing::ScopeMetadataBuilder()
+            .scope_id("com.ubuntu.scopes.soundcloud_soundcloud")
+                .display_name(" ").description(" ")
+                .author(" ")
+                .proxy(unity::scopes::ScopeProxy(soundcloud_scope))()},
+    };
+
+    MusicAggregatorQuery query1(q, hints, child_scopes);
+    MusicAggregatorQuery query2(q, hints, child_scopes);
+
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply1;
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply2;
+
+    std::shared_ptr<unity::scopes::testing::MockQueryCtrl> queryctrl(new unity::scopes::testing::MockQueryCtrl());
+
+    // the second query joins the child queries started by the first one
+    SearchListenerBase::SPtr local_listener;
+    EXPECT_CALL(*local_scope.get(), search("coalesced","", _, _, _)).WillOnce(DoAll(SaveArg<4>(&local_listener), Return(queryctrl)));
+    EXPECT_CALL(*soundcloud_scope.get(), search("coalesced","", _, _, _)).WillOnce(Return(queryctrl));
+
+    SearchReplyProxy proxy1(&reply1, [](SearchReply*){});
+    SearchReplyProxy proxy2(&reply2, [](SearchReply*){});
+    query1.run(proxy1);
+    query2.run(proxy2);
+
+    // child queries are only cancelled once nobody is interested in them anymore
+    EXPECT_CALL(*queryctrl.get(), cancel()).Times(0);
+    query1.cancelled();
+    ::testing::Mock::VerifyAndClearExpectations(queryctrl.get());
+
+    // the runtime cancels the child queries of the first query along with it,
+    // the second query then starts one of its own
+    EXPECT_CALL(*local_scope.get(), search("coalesced","", _, _, _)).WillOnce(Return(queryctrl));
+    ASSERT_TRUE(local_listener.get() != nullptr);
+    local_listener->finished(CompletionDetails(CompletionDetails::Cancelled));
+    ::testing::Mock::VerifyAndClearExpectations(local_scope.get());
+
+    EXPECT_CALL(*queryctrl.get(), cancel()).Times(1);
+    query2.cancelled();
+}
+
+TEST(TestMusicAgregator, TestInterleavedResults) {
+
+    CannedQuery q("mediascanner-music", "interleaved", "");
+    SearchMetadata hints("en_AU", "phone");
+
+    std::shared_ptr<unity::scopes::testing::MockScope> soundcloud_scope(new unity::scopes::testing::MockScope("2", "2"));
+    std::shared_ptr<unity::scopes::testing::MockScope> local_scope(new unity::scopes::testing::MockScope("6", "6"));
+
+    unity::scopes::ChildScopeList child_scopes {
+        {"mediascanner-music", unity::scopes::testing::ScopeMetadataBuilder()
+            .scope_id("mediascanner-music")
+                .display_name(" ").description(" ")
+                .author(" ")
+                .proxy(unity::scopes::ScopeProxy(local_scope))()},
+        {"com.ubuntu.scopes.soundcloud_soundcloud", unity::scopes::testing::ScopeMetadataBuilder()
+            .scope_id("com.ubuntu.scopes.soundcloud_soundcloud")
+                .display_name(" ").description(" ")
+                .author(" ")
+                .proxy(unity::scopes::ScopeProxy(soundcloud_scope))()},
+    };
+
+    // each child may show one result before its turn
+    MusicAggregatorQuery query(q, hints, child_scopes, nullptr, 1);
+
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "tracks", "Tracks", "icon", CategoryRenderer());
+    ON_CALL(reply, register_category(_, _, _, _, _)).WillByDefault(Return(category));
+    ON_CALL(reply, register_category(_, _, _, _)).WillByDefault(Return(category));
+
+    std::shared_ptr<unity::scopes::testing::MockQueryCtrl> queryctrl(new unity::scopes::testing::MockQueryCtrl());
+    SearchListenerBase::SPtr local_listener;
+    SearchListenerBase::SPtr soundcloud_listener;
+    EXPECT_CALL(*local_scope.get(), search("interleaved","", _, _, _)).WillOnce(DoAll(SaveArg<4>(&local_listener), Return(queryctrl)));
+    EXPECT_CALL(*soundcloud_scope.get(), search("interleaved","", _, _, _)).WillOnce(DoAll(SaveArg<4>(&soundcloud_listener), Return(queryctrl)));
+
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+    query.run(proxy);
+    ASSERT_TRUE(local_listener != nullptr);
+    ASSERT_TRUE(soundcloud_listener != nullptr);
+
+    CategorisedResult result(category);
+    result.set_uri("file:///track.mp3");
+    result.set_title("Track");
+
+    // the first soundcloud result shows up as soon as local music has shown something,
+    // the second one waits until local music has finished
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_))).Times(2).WillRepeatedly(Return(true));
+    local_listener->push(result);
+    soundcloud_listener->push(result);
+    soundcloud_listener->push(result);
+    ::testing::Mock::VerifyAndClearExpectations(&reply);
+
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_))).Times(1).WillRepeatedly(Return(true));
+    local_listener->finished(CompletionDetails(CompletionDetails::OK));
+    ::testing::Mock::VerifyAndClearExpectations(&reply);
+
+    soundcloud_listener->finished(CompletionDetails(CompletionDetails::OK));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -15,6 +17,7 @@
 #include <unity/scopes/testing/TypedScopeFixture.h>
 
 #include "../src/mymusic/music-scope.h"
+#include "../src/utils/metrics.h"
 
 using namespace mediascanner;
 using namespace unity::scopes;
@@ -25,6 +28,7 @@ using ::testing::Matcher;
 using ::testing::Property;
 using ::testing::Return;
 using ::testing::Truly;
+using ::testing::UnorderedElementsAre;
 
 class MusicScopeTest : public unity::scopes::testing::TypedScopeFixture<MusicScope> {
 protected:
@@ -220,6 +224,44 @@ TEST_F(MusicScopeTest, QueryResult) {
     query->run(proxy);
 }
 
+/* Results of store queries run side by side still come in category order */
+TEST_F(MusicScopeTest, ConcurrentQueryResult) {
+    populateStore();
+    ASSERT_EQ(0, setenv("MEDIASCANNER_QUERY_WORKERS", "2", 1));
+    ASSERT_EQ(0, setenv("MEDIASCANNER_UNIFIED_SEARCH", "0", 1));
+    scope->start_in_process("/no/such/directory");
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_QUERY_WORKERS"));
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_UNIFIED_SEARCH"));
+
+    Category::SCPtr artists_category = std::make_shared<unity::scopes::testing::Category>(
+        "artists", "Artists", "icon", CategoryRenderer());
+    Category::SCPtr songs_category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Tracks", "icon", CategoryRenderer());
+    Category::SCPtr albums_category = std::make_shared<unity::scopes::testing::Category>(
+        "albums", "Albums", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, register_category("artists", _, _, _))
+        .WillByDefault(Return(artists_category));
+    ON_CALL(reply, register_category("songs", _, _, _))
+        .WillByDefault(Return(songs_category));
+    ON_CALL(reply, register_category("albums", _, _, _))
+        .WillByDefault(Return(albums_category));
+
+    {
+        ::testing::InSequence seq;
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "The John Butler Trio"))))
+            .WillOnce(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "April Uprising"))))
+            .WillOnce(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "One Way Road"))))
+            .WillOnce(Return(true));
+    }
+
+    auto query = scope->search(CannedQuery("mediascanner-music", "road", ""), SearchMetadata("en_AU", "phone"));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+    query->run(proxy);
+}
+
 /* Check that we get some results for a short query */
 TEST_F(MusicScopeTest, ShortQuery) {
     populateStore();
@@ -262,6 +304,186 @@ TEST_F(MusicScopeTest, ShortQuery) {
     query->run(proxy);
 }
 
+/* Check that the key column ranks words starting with a short query above matches inside words */
+TEST_F(MusicScopeTest, KeyColumnShortQuery) {
+    populateStore();
+    MediaKeyColumn column(*store, AudioMedia);
+
+    std::vector<std::string> titles;
+    for (auto const& song: column.media_containing("r", 100)) {
+        titles.push_back(song.getTitle());
+    }
+    ASSERT_EQ(7u, titles.size());
+    // what the full text search finds, then inside words of the title, then inside the artist
+    EXPECT_THAT(std::vector<std::string>(titles.begin(), titles.begin() + 2),
+                UnorderedElementsAre("One Way Road", "Revolution"));
+    EXPECT_THAT(std::vector<std::string>(titles.begin() + 2, titles.begin() + 5),
+                UnorderedElementsAre("Straight Through The Sun", "Peaches & Cream", "Zebra"));
+    EXPECT_THAT(std::vector<std::string>(titles.begin() + 5, titles.end()),
+                UnorderedElementsAre("It's Beautiful", "Buy Me a Pony"));
+
+    // a page full of word starts needs no more
+    ASSERT_EQ(1u, column.media_containing("r", 1).size());
+    EXPECT_TRUE(titles[0] == column.media_containing("r", 1)[0].getTitle());
+}
+
+/* Check that a misspelt query still finds the artist */
+TEST_F(MusicScopeTest, QueryWithTypo) {
+    populateStore();
+    ASSERT_EQ(0, setenv("MEDIASCANNER_FUZZY_SEARCH", "1", 1));
+    scope->start_in_process("/no/such/directory");
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_FUZZY_SEARCH"));
+
+    CannedQuery q("mediascanner-music", "spidrbait", "");
+    SearchMetadata hints("en_AU", "phone");
+    auto query = scope->search(q, hints);
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "artists", "Artists", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, register_category(_, _, _, _))
+        .WillByDefault(Return(category));
+
+    CannedQuery q1("mediascanner-music", "Spiderbait", "");
+    q1.set_user_data(Variant("albums_of_artist"));
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(AllOf(
+            ResultUriMatchesCannedQuery(q1),
+            ResultProp("title", "Spiderbait")))))
+        .WillOnce(Return(true));
+
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+    query->run(proxy);
+}
+
+/* Check that case and diacritics don't matter, also without fuzzy search */
+TEST_F(MusicScopeTest, QueryWithoutDiacritics) {
+    populateStore();
+    {
+        MediaStore store(MS_READ_WRITE);
+        MediaFileBuilder builder("/path/foo8.ogg");
+        builder.setType(AudioMedia);
+        builder.setTitle("Ace of Spades");
+        builder.setAuthor("Motörhead");
+        builder.setAlbum("Ace of Spades");
+        builder.setDate("1980-11-08");
+        builder.setTrackNumber(1);
+        builder.setDuration(169);
+        store.insert(builder.build());
+    }
+
+    CannedQuery q("mediascanner-music", "MOTORHEAD", "");
+    SearchMetadata hints("en_AU", "phone");
+    auto query = scope->search(q, hints);
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "artists", "Artists", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, register_category(_, _, _, _))
+        .WillByDefault(Return(category));
+
+    CannedQuery q1("mediascanner-music", "Motörhead", "");
+    q1.set_user_data(Variant("albums_of_artist"));
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(AllOf(
+            ResultUriMatchesCannedQuery(q1),
+            ResultProp("title", "Motörhead")))))
+        .WillOnce(Return(true));
+
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+    query->run(proxy);
+}
+
+/* Check that a search extending the previous one gets its songs filtered from the previous ones */
+TEST_F(MusicScopeTest, TypeAheadQuery) {
+    populateStore();
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Tracks", "icon", CategoryRenderer());
+    SearchMetadata hints("en_AU", "phone");
+    {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+            .WillRepeatedly(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Straight Through The Sun"))))
+            .WillOnce(Return(true));
+
+        auto query = scope->search(CannedQuery("mediascanner-music", "sun", ""), hints);
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    }
+
+    auto const& hits = metrics::counter("mediascanner_type_ahead_total", "scope=\"music\",result=\"hit\"");
+    const auto hits_before = hits.value();
+    {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+            .WillRepeatedly(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Straight Through The Sun"))))
+            .Times(0);
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Peaches & Cream"))))
+            .WillOnce(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Zebra"))))
+            .WillOnce(Return(true));
+
+        auto query = scope->search(CannedQuery("mediascanner-music", "sunr", ""), hints);
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    }
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
+/* Check that a refined search finds what the store would, whether or not an earlier search is cached */
+TEST_F(MusicScopeTest, TypeAheadMatchesStore) {
+    populateStore();
+    MediaFileBuilder builder("/path/foo8.ogg");
+    builder.setType(AudioMedia);
+    builder.setTitle("Ace of Spades");
+    builder.setAuthor("Motörhead");
+    builder.setAlbum("Overkill");
+    store->insert(builder.build());
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Tracks", "icon", CategoryRenderer());
+    SearchMetadata hints("en_AU", "phone");
+    auto run = [&](std::string const& search, bool found) {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+            .WillRepeatedly(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Ace of Spades"))))
+            .Times(found ? 1 : 0)
+            .WillRepeatedly(Return(true));
+
+        auto query = scope->search(CannedQuery("mediascanner-music", search, ""), hints);
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    };
+
+    // the store doesn't fold diacritics, so "moto" doesn't start "motörhead"
+    ASSERT_EQ(0, setenv("MEDIASCANNER_TYPE_AHEAD", "0", 1));
+    scope->start_in_process("/no/such/directory");
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_TYPE_AHEAD"));
+    run("moto", false);
+
+    scope->start_in_process("/no/such/directory");
+    auto const& hits = metrics::counter("mediascanner_type_ahead_total", "scope=\"music\",result=\"hit\"");
+    const auto hits_before = hits.value();
+    run("mot", true);
+    run("moto", false);
+    EXPECT_EQ(hits_before + 1, hits.value());
+    // a new word isn't refined
+    run("moto s", false);
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
 TEST_F(MusicScopeTest, SurfacingQuery) {
     populateStore();
 
@@ -332,6 +554,124 @@ TEST_F(MusicScopeTest, TracksDepartmentSurfacing) {
     query->run(proxy);
 }
 
+TEST_F(MusicScopeTest, TracksDepartmentPlaylists) {
+    const int songs = 50;
+    for (int i = 0; i < songs; i++) {
+        MediaFileBuilder builder("/path/song" + std::to_string(i) + ".ogg");
+        builder.setType(AudioMedia);
+        builder.setTitle("Song " + std::to_string(i));
+        builder.setAuthor("Spiderbait");
+        builder.setAlbum("Spiderbait");
+        store->insert(builder.build());
+    }
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Tracks", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, register_category("songs", _, _, _))
+        .WillByDefault(Return(category));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+    std::vector<CategorisedResult> results;
+    auto query = scope->search(CannedQuery("mediascanner-music", "", "tracks"), SearchMetadata("en_AU", "phone"));
+    dynamic_cast<MusicQuery&>(*query).run_in_process(proxy, [&results](CategorisedResult const& result) {
+            results.push_back(result);
+            return true;
+        });
+    ASSERT_EQ(std::size_t(songs), results.size());
+
+    // every card plays a window of the songs listed around it, itself included
+    for (std::size_t i = 0; i < results.size(); i++) {
+        auto const playlist = results[i]["audio-data"].get_dict().at("playlist").get_array();
+        ASSERT_EQ(20u, playlist.size()) << i;
+        auto const first = std::find_if(results.begin(), results.end(), [&playlist](CategorisedResult const& r) {
+                return r.uri() == playlist[0].get_string();
+            }) - results.begin();
+        EXPECT_LE(std::size_t(first), i);
+        EXPECT_GT(first + playlist.size(), i);
+        for (std::size_t j = 0; j < playlist.size(); j++) {
+            EXPECT_EQ(results[first + j].uri(), playlist[j].get_string());
+        }
+    }
+    // the first song starts its playlist, later ones have a few songs before them
+    EXPECT_EQ(results[0].uri(), results[0]["audio-data"].get_dict().at("playlist").get_array()[0].get_string());
+    EXPECT_EQ(results[20].uri(), results[25]["audio-data"].get_dict().at("playlist").get_array()[0].get_string());
+}
+
+TEST_F(MusicScopeTest, RepeatedQuery) {
+    populateStore();
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "songs", "Tracks", "icon", CategoryRenderer());
+    SearchMetadata hints("en_AU", "phone");
+    auto run = [&](bool with_new_song) {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        EXPECT_CALL(reply, register_departments(_));
+        EXPECT_CALL(reply, register_category("songs", _, _, _))
+            .WillOnce(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+            .Times(7)
+            .WillRepeatedly(Return(true));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Ace of Spades"))))
+            .Times(with_new_song ? 1 : 0)
+            .WillRepeatedly(Return(true));
+
+        auto query = scope->search(CannedQuery("mediascanner-music", "", "tracks"), hints);
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    };
+
+    auto const& hits = metrics::counter("mediascanner_result_cache_total", "scope=\"music\",result=\"hit\"");
+    const auto hits_before = hits.value();
+    run(false);
+    EXPECT_EQ(hits_before, hits.value());
+    // the same query again gets replayed
+    run(false);
+    EXPECT_EQ(hits_before + 1, hits.value());
+
+    // but not once the database changed
+    MediaFileBuilder builder("/path/foo8.ogg");
+    builder.setType(AudioMedia);
+    builder.setTitle("Ace of Spades");
+    builder.setAuthor("Motörhead");
+    builder.setAlbum("Ace of Spades");
+    store->insert(builder.build());
+    run(true);
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
+/* Check that a reply recorded while offline isn't replayed once online */
+TEST_F(MusicScopeTest, RepeatedQueryConnectivity) {
+    populateStore();
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "albums", "Albums", "icon", CategoryRenderer());
+    CannedQuery q("mediascanner-music", "Spiderbait", "");
+    q.set_user_data(Variant("albums_of_artist"));
+    auto run = [&](QueryMetadata::ConnectivityStatus connectivity) {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(_)))
+            .WillRepeatedly(Return(true));
+
+        SearchMetadata hints("en_AU", "phone");
+        hints.set_internet_connectivity(connectivity);
+        auto query = scope->search(q, hints);
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    };
+
+    auto const& hits = metrics::counter("mediascanner_result_cache_total", "scope=\"music\",result=\"hit\"");
+    const auto hits_before = hits.value();
+    run(QueryMetadata::Disconnected);
+    run(QueryMetadata::Disconnected);
+    EXPECT_EQ(hits_before + 1, hits.value());
+    // the artist's biography may be there now
+    run(QueryMetadata::Connected);
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
 TEST_F(MusicScopeTest, GenresDepartmentSurfacing) {
     populateStore();
 
@@ -554,7 +894,10 @@ TEST_F(MusicScopeTest, PreviewAlbum) {
                         play.at("id").get_string() == "play" &&
                         play.at("uri").get_string() == "album:///The%20John%20Butler%20Trio/April%20Uprising";
                 })
-            ),
+            )))))
+        .WillOnce(Return(true));
+    // the track list comes once it has been read from the database
+    EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(ElementsAre(
         AllOf(
             Property(&PreviewWidget::id, "tracks"),
             Property(&PreviewWidget::widget_type, "audio"),
@@ -579,6 +922,154 @@ TEST_F(MusicScopeTest, PreviewAlbum) {
     previewer->run(proxy);
 }
 
+TEST_F(MusicScopeTest, PreviewAlbumCancelled) {
+    populateStore();
+
+    unity::scopes::testing::Result result;
+    result.set_uri("album:///The%20John%20Butler%20Trio/April%20Uprising");
+    result.set_title("April Uprising");
+    result["artist"] = "The John Butler Trio";
+    result["album"] = "April Uprising";
+    result["isalbum"] = true;
+
+    ActionMetadata hints("en_AU", "phone");
+    auto previewer = scope->preview(result, hints);
+
+    ::testing::NiceMock<unity::scopes::testing::MockPreviewReply> reply;
+    EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(_)))
+        .WillOnce(Return(true));
+
+    // the user backed out before the track list got read
+    previewer->cancelled();
+    PreviewReplyProxy proxy(&reply, [](PreviewReply*){});
+    previewer->run(proxy);
+}
+
+/* Check that albums too long to embed leave their allowance to the next ones */
+TEST_F(MusicScopeTest, EmbeddedTracksSkipLongAlbums) {
+    populateStore();
+    for (int i = 0; i < 31; i++) {
+        MediaFileBuilder builder("/path/long" + std::to_string(i) + ".ogg");
+        builder.setType(AudioMedia);
+        builder.setTitle("Part " + std::to_string(i));
+        builder.setAuthor("Spiderbait");
+        builder.setAlbum("Aardvark");
+        builder.setTrackNumber(i + 1);
+        store->insert(builder.build());
+    }
+    ASSERT_EQ(0, setenv("MEDIASCANNER_EMBED_ALBUM_TRACKS", "1", 1));
+    scope->start_in_process("/no/such/directory");
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_EMBED_ALBUM_TRACKS"));
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "albums", "Albums", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+    ON_CALL(reply, register_category(_, _, _, _))
+        .WillByDefault(Return(category));
+    std::vector<CategorisedResult> albums;
+    auto query = scope->search(CannedQuery("mediascanner-music", "", "albums"), SearchMetadata("en_AU", "phone"));
+    SearchReplyProxy proxy(&reply, [](SearchReply*){});
+    dynamic_cast<MusicQuery&>(*query).run_in_process(proxy, [&albums](CategorisedResult const& result) {
+            albums.push_back(result);
+            return true;
+        });
+
+    std::vector<std::string> embedded;
+    for (auto const& album: albums) {
+        if (album.contains("tracks")) {
+            embedded.push_back(album.title());
+        }
+    }
+    ASSERT_EQ(1u, embedded.size());
+    EXPECT_NE("Aardvark", embedded[0]);
+}
+
+TEST_F(MusicScopeTest, PreviewAlbumWithEmbeddedTracks) {
+    populateStore();
+    ASSERT_EQ(0, setenv("MEDIASCANNER_EMBED_ALBUM_TRACKS", "10", 1));
+    scope->start_in_process("/no/such/directory");
+    ASSERT_EQ(0, unsetenv("MEDIASCANNER_EMBED_ALBUM_TRACKS"));
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "albums", "Albums", "icon", CategoryRenderer());
+    ::testing::NiceMock<unity::scopes::testing::MockSearchReply> search_reply;
+    ON_CALL(search_reply, register_category(_, _, _, _))
+        .WillByDefault(Return(category));
+    std::vector<CategorisedResult> albums;
+    auto query = scope->search(CannedQuery("mediascanner-music", "", "albums"), SearchMetadata("en_AU", "phone"));
+    SearchReplyProxy search_proxy(&search_reply, [](SearchReply*){});
+    dynamic_cast<MusicQuery&>(*query).run_in_process(search_proxy, [&albums](CategorisedResult const& result) {
+            albums.push_back(result);
+            return true;
+        });
+
+    auto const album = std::find_if(albums.begin(), albums.end(), [](CategorisedResult const& result) {
+            return result.title() == "April Uprising";
+        });
+    ASSERT_NE(albums.end(), album);
+    ASSERT_TRUE(album->contains("tracks"));
+    EXPECT_EQ(2u, (*album)["tracks"].get_array().size());
+
+    // the preview doesn't look the tracks up again
+    auto const& misses = metrics::counter("mediascanner_album_tracks_cache_total", "result=\"miss\"");
+    auto const& hits = metrics::counter("mediascanner_album_tracks_cache_total", "result=\"hit\"");
+    const auto lookups_before = misses.value() + hits.value();
+    ::testing::NiceMock<unity::scopes::testing::MockPreviewReply> reply;
+    EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(_)))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(ElementsAre(
+        AllOf(
+            Property(&PreviewWidget::id, "tracks"),
+            Truly([](const PreviewWidget &w) -> bool {
+                    const auto tracks = w.attribute_values().at("tracks").get_array();
+                    return tracks.size() == 2 && tracks[0].get_dict().at("title").get_string() == "Revolution";
+                })
+            )))))
+        .WillOnce(Return(true));
+    auto previewer = scope->preview(*album, ActionMetadata("en_AU", "phone"));
+    PreviewReplyProxy proxy(&reply, [](PreviewReply*){});
+    previewer->run(proxy);
+    EXPECT_EQ(lookups_before, misses.value() + hits.value());
+}
+
+TEST_F(MusicScopeTest, PreviewAlbumAgain) {
+    populateStore();
+
+    unity::scopes::testing::Result result;
+    result.set_uri("album:///The%20John%20Butler%20Trio/April%20Uprising");
+    result.set_title("April Uprising");
+    result["artist"] = "The John Butler Trio";
+    result["album"] = "April Uprising";
+    result["isalbum"] = true;
+    ActionMetadata hints("en_AU", "phone");
+
+    auto const& hits = metrics::counter("mediascanner_album_tracks_cache_total", "result=\"hit\"");
+    const auto hits_before = hits.value();
+    for (int i = 0; i < 2; i++) {
+        ::testing::NiceMock<unity::scopes::testing::MockPreviewReply> reply;
+        EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(_)))
+            .WillRepeatedly(Return(true));
+        EXPECT_CALL(reply, push(Matcher<PreviewWidgetList const&>(Truly([](PreviewWidgetList const& widgets) -> bool {
+                        for (auto const& w: widgets) {
+                            if (w.id() == "tracks") {
+                                const auto tracks = w.attribute_values().at("tracks").get_array();
+                                return tracks.size() == 2 &&
+                                    tracks[0].get_dict().at("title").get_string() == "Revolution" &&
+                                    tracks[1].get_dict().at("title").get_string() == "One Way Road";
+                            }
+                        }
+                        return false;
+                    }))))
+            .WillOnce(Return(true));
+
+        auto previewer = scope->preview(result, hints);
+        PreviewReplyProxy proxy(&reply, [](PreviewReply*){});
+        previewer->run(proxy);
+    }
+    // the second preview got the track list from the cache
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../src/utils/substringscan.h"
+
+/* Check every kernel against memmem() on haystacks of a small alphabet,
+   with lengths around the vector widths. */
+TEST(SubstringScanTest, KernelsAgreeWithMemmem) {
+    std::mt19937 random(42);
+    auto const finders = substring_finders();
+    for (int round = 0; round < 20000; round++) {
+        std::string haystack(random() % 100, ' ');
+        for (auto& c: haystack) {
+            c = "ab\x1f"[random() % 3];
+        }
+        std::string needle(1 + random() % 5, ' ');
+        for (auto& c: needle) {
+            c = "ab\x1f"[random() % 3];
+        }
+
+        auto const expected = static_cast<const char*>(memmem(haystack.data(), haystack.size(), needle.data(), needle.size()));
+        for (auto const& finder: finders) {
+            ASSERT_EQ(expected, finder.second(haystack.data(), haystack.size(), needle.data(), needle.size()))
+                << finder.first << " looking for '" << needle << "' in '" << haystack << "'";
+        }
+    }
+}
+
+TEST(SubstringScanTest, FindsMatchAtTheEnd) {
+    const std::string haystack = std::string(1000, 'x') + "needle";
+    for (auto const& finder: substring_finders()) {
+        EXPECT_EQ(haystack.data() + 1000, finder.second(haystack.data(), haystack.size(), "needle", 6)) << finder.first;
+        EXPECT_EQ(nullptr, finder.second(haystack.data(), haystack.size() - 1, "needle", 6)) << finder.first;
+    }
+    EXPECT_EQ(haystack.data() + 1000, find_substring(haystack.data(), haystack.size(), "needle", 6));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <mediascanner/MediaStore.hh>
+#include <unity/scopes/CannedQuery.h>
+#include <unity/scopes/SearchMetadata.h>
+#include <unity/scopes/testing/Category.h>
+#include <unity/scopes/testing/MockSearchReply.h>
+#include <unity/scopes/testing/TypedScopeFixture.h>
+
+#include "../benchmarks/synthetic-library.h"
+#include "../src/mymusic/music-scope.h"
+#include "../src/utils/metrics.h"
+
+using namespace mediascanner;
+using namespace unity::scopes;
+using ::testing::_;
+using ::testing::Invoke;
+
+/*
+   A search answered from a single scan of the matching songs has to give
+   the results the separate artist, album and song searches give. Only the
+   artist art may differ: the scan takes it from the matching songs.
+*/
+
+namespace
+{
+
+// (uri, title, art) of the results in each category
+struct Results
+{
+    std::vector<std::tuple<std::string, std::string, std::string>> artists;
+    std::vector<std::tuple<std::string, std::string, std::string>> albums;
+    std::vector<std::tuple<std::string, std::string, std::string>> songs;
+};
+
+}
+
+class UnifiedSearchTest : public unity::scopes::testing::TypedScopeFixture<MusicScope> {
+protected:
+    virtual void SetUp() {
+        cachedir = "/tmp/mediastore.XXXXXX";
+        // mkdtemp edits the string in place without changing its length
+        if (mkdtemp(const_cast<char*>(cachedir.c_str())) == nullptr) {
+            throw std::runtime_error(strerror(errno));
+        }
+        ASSERT_EQ(0, setenv("MEDIASCANNER_CACHEDIR", cachedir.c_str(), 1));
+        {
+            MediaStore store(MS_READ_WRITE);
+            populate_synthetic_library(store, 1000, 0);
+        }
+        set_scope_directory("/no/such/directory");
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::SetUp();
+    }
+
+    virtual void TearDown() {
+        unity::scopes::testing::TypedScopeFixture<MusicScope>::TearDown();
+        unsetenv("MEDIASCANNER_UNIFIED_SEARCH");
+        std::string cmd = "rm -rf " + cachedir;
+        ASSERT_EQ(0, system(cmd.c_str()));
+    }
+
+    Results search(std::string const& query_string, bool unified) {
+        setenv("MEDIASCANNER_UNIFIED_SEARCH", unified ? "1" : "0", 1);
+        // reopening also drops the caches of the previous search
+        scope->start_in_process("/no/such/directory");
+
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Invoke([](std::string const& id, std::string const& title, std::string const& icon, CategoryRenderer const& renderer) {
+                        return Category::SCPtr(std::make_shared<unity::scopes::testing::Category>(id, title, icon, renderer));
+                    }));
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+
+        Results results;
+        auto query = scope->search(CannedQuery("mediascanner-music", query_string, ""), SearchMetadata("en_AU", "phone"));
+        dynamic_cast<MusicQuery&>(*query).run_in_process(proxy, [&results](CategorisedResult const& result) {
+                auto const id = result.category()->id();
+                auto& list = id == "artists" ? results.artists : id == "albums" ? results.albums : results.songs;
+                list.emplace_back(result.uri(), result.title(), result.art());
+                return true;
+            });
+        return results;
+    }
+
+    std::string cachedir;
+};
+
+TEST_F(UnifiedSearchTest, SameResults) {
+    std::vector<std::string> queries(synthetic_words.begin(), synthetic_words.begin() + 12);
+    queries.insert(queries.end(), {"summer night", "synthetic band", "café", "zzyzx"});
+
+    auto const& query_artists = metrics::histogram("mediascanner_store_call_seconds",
+            "scope=\"music\",call=\"MediaStore::queryArtists\"");
+    int scanned_queries = 0;
+    for (auto const& q: queries) {
+        SCOPED_TRACE(q);
+        const Results separate = search(q, false);
+        const auto separate_calls = query_artists.count();
+        const Results unified = search(q, true);
+        // searches matching fewer songs than the result limit find their artists in the scan
+        const bool scanned = unified.songs.size() < 100;
+        EXPECT_EQ(separate_calls + (scanned ? 0 : 1), query_artists.count());
+        scanned_queries += scanned;
+
+        // uri, title and art of every result, in the same order
+        ASSERT_EQ(separate.artists.size(), unified.artists.size());
+        for (std::size_t i = 0; i < separate.artists.size(); i++) {
+            EXPECT_EQ(std::get<0>(separate.artists[i]), std::get<0>(unified.artists[i]));
+            EXPECT_EQ(std::get<1>(separate.artists[i]), std::get<1>(unified.artists[i]));
+            if (!scanned) {
+                EXPECT_EQ(std::get<2>(separate.artists[i]), std::get<2>(unified.artists[i]));
+            }
+        }
+        EXPECT_EQ(separate.albums, unified.albums);
+        EXPECT_EQ(separate.songs, unified.songs);
+    }
+    EXPECT_LT(0, scanned_queries);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
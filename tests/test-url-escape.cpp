@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include <core/net/http/client.h>
+#include <core/net/uri.h>
+#include <gtest/gtest.h>
+
+#include "../src/utils/artistartcache.h"
+#include "../src/utils/urlescape.h"
+
+namespace http = core::net::http;
+
+namespace
+{
+
+// names with spaces, reserved and non-ASCII characters
+const std::vector<std::string> names = {
+    "",
+    "Spiderbait",
+    "The John Butler Trio",
+    "AC/DC",
+    "Guns N' Roses",
+    "Simon & Garfunkel",
+    "Sigur Rós",
+    "Motörhead",
+    "坂本龍一",
+    "100% Pure ~ Love?",
+    "a+b=c; d#e",
+    "-._~",
+};
+
+}
+
+TEST(UrlEscapeTest, SameAsHttpClient) {
+    auto client = http::make_client();
+    for (auto const& name: names) {
+        EXPECT_EQ(client->url_escape(name), url_escape(name)) << name;
+    }
+}
+
+TEST(UrlEscapeTest, Appends) {
+    std::string uri = "album:///";
+    append_url_escaped(uri, "Sigur Rós");
+    EXPECT_EQ("album:///Sigur%20R%C3%B3s", uri);
+}
+
+TEST(ArtistArtCacheTest, SameAsHttpClient) {
+    auto client = http::make_client();
+    ArtistArtCache cache;
+    for (auto const& artist: names) {
+        auto const expected = client->uri_to_string(core::net::make_uri(
+                "image://artistart", {}, {{"artist", artist}, {"album", "Sunrise Over Sea"}}));
+        EXPECT_EQ(expected, ArtistArtCache::make_uri(artist, "Sunrise Over Sea")) << artist;
+        // both when the URI gets made and when it comes from the cache
+        EXPECT_EQ(expected, cache.get(artist, "Sunrise Over Sea")) << artist;
+        EXPECT_EQ(expected, cache.get(artist, "Sunrise Over Sea")) << artist;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
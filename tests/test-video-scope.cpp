@@ -15,6 +15,7 @@
 #include <unity/scopes/testing/TypedScopeFixture.h>
 
 #include "../src/myvideos/video-scope.h"
+#include "../src/utils/metrics.h"
 
 using namespace mediascanner;
 using namespace unity::scopes;
@@ -154,6 +155,39 @@ TEST_F(VideoScopeTest, ShortQuery) {
     query->run(proxy);
 }
 
+/* Check that a query cancelled while it ran doesn't get replayed */
+TEST_F(VideoScopeTest, CancelledQueryNotReplayed) {
+    populateStore();
+
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "local", "My Videos", "icon", CategoryRenderer());
+    CannedQuery q("mediascanner-video", "bunny", "");
+    SearchMetadata hints("en_AU", "phone");
+    auto run = [&](bool cancel) {
+        ::testing::NiceMock<unity::scopes::testing::MockSearchReply> reply;
+        ON_CALL(reply, register_category(_, _, _, _))
+            .WillByDefault(Return(category));
+        EXPECT_CALL(reply, push(Matcher<CategorisedResult const&>(ResultProp("title", "Big Buck Bunny"))))
+            .WillOnce(Return(true));
+
+        auto query = scope->search(q, hints);
+        if (cancel) {
+            query->cancelled();
+        }
+        SearchReplyProxy proxy(&reply, [](SearchReply*){});
+        query->run(proxy);
+    };
+
+    auto const& hits = metrics::counter("mediascanner_result_cache_total", "scope=\"video\",result=\"hit\"");
+    const auto hits_before = hits.value();
+    run(true);
+    run(false);
+    EXPECT_EQ(hits_before, hits.value());
+    // the query that ran to the end does
+    run(false);
+    EXPECT_EQ(hits_before + 1, hits.value());
+}
+
 TEST_F(VideoScopeTest, SurfacingQuery) {
     populateStore();
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2016 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <unity/scopes/CategorisedResult.h>
+#include <unity/scopes/testing/Category.h>
+
+#include "../src/utils/reorderbuffer.h"
+#include "../src/utils/workerpool.h"
+
+using namespace unity::scopes;
+
+TEST(WorkerPoolTest, RunsJobsSideBySide) {
+    WorkerPool pool(2);
+    std::promise<void> first_started;
+    auto started = first_started.get_future();
+    // the second job can only finish if the first one is running at the same time
+    auto first = pool.submit([&first_started] { first_started.set_value(); });
+    auto second = pool.submit([&started] {
+            ASSERT_EQ(std::future_status::ready, started.wait_for(std::chrono::seconds(10)));
+        });
+    first.get();
+    second.get();
+}
+
+TEST(WorkerPoolTest, PassesOnExceptions) {
+    WorkerPool pool(1);
+    auto job = pool.submit([] { throw std::runtime_error("failed"); });
+    EXPECT_THROW(job.get(), std::runtime_error);
+}
+
+TEST(ReorderBufferTest, PushesLaneByLane) {
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    auto result = [&category](std::string const& title) {
+        CategorisedResult res(category);
+        res.set_uri("uri:" + title);
+        res.set_title(title);
+        return res;
+    };
+
+    ReorderBuffer buffer(3);
+    std::thread last([&] {
+            ReorderBuffer::Lane lane(buffer, 2);
+            ASSERT_EQ(&lane, ReorderBuffer::current_lane());
+            lane.push(result("c1"));
+            lane.push(result("c2"));
+        });
+    std::thread middle([&] {
+            ReorderBuffer::Lane lane(buffer, 1);
+            lane.push(result("b1"));
+        });
+    std::thread first([&] {
+            ReorderBuffer::Lane lane(buffer, 0);
+            lane.push(result("a1"));
+            lane.push(result("a2"));
+        });
+
+    std::vector<std::string> titles;
+    EXPECT_TRUE(buffer.drain([&titles](CategorisedResult const& res) {
+                titles.push_back(res.title());
+                return true;
+            }));
+    last.join();
+    middle.join();
+    first.join();
+    EXPECT_EQ((std::vector<std::string>{"a1", "a2", "b1", "c1", "c2"}), titles);
+    EXPECT_EQ(nullptr, ReorderBuffer::current_lane());
+}
+
+TEST(ReorderBufferTest, StopsWhenRejected) {
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    CategorisedResult res(category);
+    res.set_uri("uri");
+
+    ReorderBuffer buffer(1);
+    std::promise<void> drained;
+    std::thread producer([&] {
+            ReorderBuffer::Lane lane(buffer, 0);
+            EXPECT_TRUE(lane.push(res));
+            drained.get_future().wait();
+            EXPECT_FALSE(lane.push(res));
+        });
+    EXPECT_FALSE(buffer.drain([](CategorisedResult const&) { return false; }));
+    drained.set_value();
+    producer.join();
+}
+
+TEST(ReorderBufferTest, BoundsLanes) {
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    CategorisedResult res(category);
+    res.set_uri("uri");
+
+    ReorderBuffer buffer(2, 2);
+    std::atomic<int> pushed(0);
+    std::thread later([&] {
+            ReorderBuffer::Lane lane(buffer, 1);
+            for (int i = 0; i < 5; i++) {
+                EXPECT_TRUE(lane.push(res));
+                pushed++;
+            }
+        });
+    // the second lane fills up while the first one is still open, and stays full
+    for (int i = 0; i < 1000 && pushed < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(2, pushed);
+
+    int drained = 0;
+    std::thread first([&] {
+            ReorderBuffer::Lane lane(buffer, 0);
+        });
+    EXPECT_TRUE(buffer.drain([&drained](CategorisedResult const&) {
+                drained++;
+                return true;
+            }));
+    first.join();
+    later.join();
+    EXPECT_EQ(5, drained);
+}
+
+TEST(ReorderBufferTest, RejectReleasesFullLane) {
+    Category::SCPtr category = std::make_shared<unity::scopes::testing::Category>(
+        "category", "Category", "icon", CategoryRenderer());
+    CategorisedResult res(category);
+    res.set_uri("uri");
+
+    ReorderBuffer buffer(1, 1);
+    std::promise<void> filled;
+    std::thread producer([&] {
+            ReorderBuffer::Lane lane(buffer, 0);
+            EXPECT_TRUE(lane.push(res));
+            filled.set_value();
+            // waits for room nobody drains, until the buffer is rejected
+            EXPECT_FALSE(lane.push(res));
+        });
+    filled.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    buffer.reject();
+    producer.join();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}